@@ -336,7 +336,7 @@ class DssClientLib(object):
         :return: List of object keys.
         """
         try:
-            objects = self.dss_client.getObjects(prefix, delimiter, True, self.object_keys_per_page_count)
+            objects = self.dss_client.getObjects(prefix, delimiter, True, self.object_keys_per_page_count, prefetch=2)
             while True:
                 try:
                     object_keys = []
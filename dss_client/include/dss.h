@@ -38,20 +38,85 @@
 #include <aws/s3/S3Client.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/numpy.h>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <regex>
+#include <set>
+#include <thread>
+
+#include "dss_keyindex.h"
+#include "dss_keylist.h"
 
 namespace dss {
 	namespace py = pybind11;
 
 #define DSS_VER					"20210217"
 #define DSS_PAGINATION_DEFAULT	100UL
+#define DSS_SPLIT_PROBE_KEYS	1000UL
+// U+10FFFF, sorts after any character that may follow a key prefix
+#define DSS_KEY_MAX_CHAR	"\xf4\x8f\xbf\xbf"
+#define DSS_PART_WORKERS_PER_EP	4U
+// Threads one call spreads over a cluster's endpoints, whatever their number
+#define DSS_PART_WORKERS		64U
+#define DSS_WARMUP_WORKERS		64U
+#define DSS_MULTIPART_MIN_PART	(5LL << 20)
+#define DSS_MULTIPART_MAX_PARTS	10000LL
 
 	class Endpoint;
 	class Result;
+	struct Request;
+	class Cluster;
 	class ClusterMap;
+	class FileSink;
+	class BufferPool;
+	class PoolBuffer;
 
 	using Credentials = Aws::Auth::AWSCredentials;
 	using Config = Aws::Client::ClientConfiguration;
 	using Callback = std::function<void(void*, std::string, std::string, int)>;
+	/* Called for every listed object with its key and size */
+	using ObjectVisitor = std::function<void(const char*, size_t, int64_t)>;
+
+	/* Object keys a listing returns, checked as pages arrive so that
+	 * discarded keys never reach Python. A key must end with one of the
+	 * suffixes, match the glob (fnmatch, '*' crosses '/'), contain a
+	 * match of the regex and have a size within [min_size, max_size].
+	 * Empty fields and negative sizes don't filter */
+	class ListFilter {
+		public:
+			ListFilter() : m_min_size(-1), m_max_size(-1) {}
+			ListFilter(const std::vector<std::string>& suffixes, const std::string& glob,
+					const std::string& regex, int64_t min_size, int64_t max_size);
+
+			bool Empty() const
+			{
+				return m_suffixes.empty() && m_glob.empty() && !m_regex && !HasSizeBounds();
+			}
+			bool HasSizeBounds() const { return m_min_size >= 0 || m_max_size >= 0; }
+			/* size < 0 means unknown, the size bounds are then not checked */
+			bool Match(const char* key, size_t len, int64_t size) const;
+
+		private:
+			std::vector<std::string> m_suffixes;
+			std::string m_glob;
+			std::shared_ptr<const std::regex> m_regex;
+			int64_t m_min_size;
+			int64_t m_max_size;
+	};
+
+	struct PrefixSummary {
+		uint64_t count;
+		uint64_t bytes;
+	};
+
+	struct ObjectStat {
+		int64_t size;
+		std::string etag;
+		int64_t mtime; // ms since the epoch
+	};
 
 	class NoSuchResourceError : std::exception {
 		public:
@@ -114,6 +179,20 @@ namespace dss {
 			connectTimeoutMs = 1000;
 			enableTcpKeepAlive = true;
 			tcpKeepAliveIntervalMs = 30000;
+			warmupConnections = 0;
+			shareEndpoints = true;
+			listCacheTtlMs = 0;
+			directIO = false;
+			fileBlockSize = 4 << 20;
+			atomicDownload = false;
+			rangedGetThreshold = 0;
+			rangedGetPartSize = 8 << 20;
+			multipartThreshold = 0;
+			multipartPartSize = 16 << 20;
+			multipartRetries = 3;
+			bufferPoolMaxSize = 64 << 20;
+			bufferPoolPerClass = 32;
+			bufferPoolHugePages = false;
 		}
 
 		std::string scheme;
@@ -124,17 +203,61 @@ namespace dss {
 		int connectTimeoutMs;
 		int enableTcpKeepAlive;
 		int tcpKeepAliveIntervalMs;
+		int warmupConnections; // keep-alive connections opened per endpoint at creation, 0 = off
+		bool shareEndpoints; // reuse endpoints and cluster map of an identical client in this process
+		// Locality of this client, matched against the optional endpoint
+		// labels in conf.json to prefer nearby endpoints
+		std::string rack;
+		std::string subnet;
+		std::string zone;
+		// Local interfaces or source addresses to spread connections over
+		// (e.g. "ens1f0", "host!10.0.0.5"), empty = let the kernel route
+		std::vector<std::string> localInterfaces;
+		// Keep complete cluster listings this long and serve repeated
+		// listings of the same prefix from memory, 0 = off
+		unsigned listCacheTtlMs;
+		// Downloads to file are written in blocks of this size, with
+		// O_DIRECT when directIO is set and the filesystem supports it
+		bool directIO;
+		unsigned fileBlockSize;
+		// Downloads to a regular file go to a temporary file renamed over
+		// it once complete, instead of truncating and writing in place
+		bool atomicDownload;
+		// Objects of at least this many bytes are downloaded as parallel
+		// ranges of rangedGetPartSize spread over the cluster's endpoints,
+		// 0 = off
+		long long rangedGetThreshold;
+		long long rangedGetPartSize;
+		// Uploads of at least this many bytes go as a multipart upload,
+		// parts sent in parallel over the cluster's endpoints and each
+		// retried up to multipartRetries times, 0 = off
+		long long multipartThreshold;
+		long long multipartPartSize;
+		unsigned multipartRetries;
+		// Pooled GET buffers come in power-of-two classes up to this size,
+		// up to bufferPoolPerClass released buffers of each are kept
+		long long bufferPoolMaxSize;
+		unsigned bufferPoolPerClass;
+		bool bufferPoolHugePages;
 	};
 
 	class Objects {
 		public:
-			Objects(ClusterMap* map, std::string prefix, std::string delimiter, bool cp, uint32_t ps) :
+			Objects(ClusterMap* map, std::string prefix, std::string delimiter, bool cp, uint32_t ps,
+					uint32_t prefetch = 0) :
 				m_cur_id(-1),
 				m_cluster_map(map),
 				m_prefix(prefix),
 				m_delim(delimiter),
 				m_comm_prefix(cp),
-				m_pagesize(ps) {}
+				m_pagesize(ps),
+				m_infos(nullptr),
+				m_cache_pos(0),
+				m_sharded(false),
+				m_prefetch(prefetch),
+				m_done(false),
+				m_stop(false) {}
+			~Objects();
 			const char *GetPrefix() { return m_prefix.c_str(); }
 			std::string& GetDelim() { return m_delim; }
 			uint32_t GetPageSize() { return m_pagesize; }
@@ -145,10 +268,38 @@ namespace dss {
 			bool TokenSet() { return m_token.size() != 0; }
 			bool NeedCommPrefix() { return m_comm_prefix; }
 			bool PageSizeSet() { return m_pagesize != 0; }
-			std::set<std::string>& GetPage() { return m_page; }
+			/* Page currently being filled by the listing */
+			KeyList& GetPage() { return m_fill; }
 			std::set<std::string>& GetCPre() { return m_cps;}
+			/* Only list keys in (start_after, last], empty means unbounded */
+			void SetRange(const std::string& start_after, const std::string& last)
+			{
+				m_start_after = start_after;
+				m_last = last;
+			}
+			const std::string& GetStartAfter() { return m_start_after; }
+			const std::string& GetLast() { return m_last; }
+			/* When set, objects go to infos with their metadata instead of
+			 * the key page */
+			void SetInfos(ObjectInfos* infos) { m_infos = infos; }
+			ObjectInfos* GetInfos() { return m_infos; }
+			/* When set, objects are only handed to the visitor */
+			void SetVisitor(ObjectVisitor v) { m_visitor = std::move(v); }
+			const ObjectVisitor& GetVisitor() { return m_visitor; }
+			void SetFilter(const ListFilter& f) { m_filter = f; }
+			const ListFilter& GetFilter() { return m_filter; }
+			/* Only list the share of the keys owned by rank */
+			void SetShard(uint32_t rank, uint32_t world_size);
+			/* With a listing cache, pages are cut from whole cluster
+			 * listings returned by the lister */
+			using ClusterLister = std::function<std::shared_ptr<const KeyList>(Cluster*)>;
+			void SetLister(ClusterLister l) { m_lister = std::move(l); }
 
 		private:
+			int FetchPage();
+			int FetchCachedPage();
+			void Prefetch();
+
 			int m_cur_id;
 			Aws::String m_token;
 			bool m_token_set;
@@ -157,11 +308,41 @@ namespace dss {
 			std::string m_delim;
 			bool m_comm_prefix;
 			uint32_t m_pagesize;
-			std::set<std::string> m_page;
+			KeyList m_page;
+			KeyList m_fill;
 			std::set<std::string> m_cps;
+			std::string m_start_after;
+			std::string m_last;
+			ObjectInfos* m_infos;
+			ObjectVisitor m_visitor;
+			ListFilter m_filter;
+			ClusterLister m_lister;
+			std::shared_ptr<const KeyList> m_cached;
+			size_t m_cache_pos;
+
+			/* A sharded listing walks its own (cluster, key range) units
+			 * instead of every cluster */
+			struct ListUnit {
+				uint32_t cluster;
+				std::string start_after;
+				std::string last;
+			};
+			std::vector<ListUnit> m_units;
+			bool m_sharded;
+
+			/* With m_prefetch > 0 a worker keeps listing ahead of the
+			 * consumer and parks up to m_prefetch pages in m_ready */
+			uint32_t m_prefetch;
+			std::deque<KeyList> m_ready;
+			bool m_done;
+			bool m_stop;
+			std::exception_ptr m_error;
+			std::thread m_worker;
+			std::mutex m_mutex;
+			std::condition_variable m_cv;
 		public:
-			decltype(m_page.cbegin()) begin() const { return m_page.cbegin(); }
-			decltype(m_page.cend()) end() const { return m_page.cend(); }
+			KeyList::const_iterator begin() const { return m_page.begin(); }
+			KeyList::const_iterator end() const { return m_page.end(); }
 	};
 
 	class Client {
@@ -172,6 +353,8 @@ namespace dss {
 			int InitClusterMap(const std::string& uuid, const unsigned int max_endpoints);
 			Result TryLockClusters();
 			Result UnlockClusters();
+			long WarmupConnections(unsigned int count);
+			long GetWarmupTime() { return m_warmup_ms; }
 			static std::unique_ptr<Client> CreateClient(const std::string& url,
 					const std::string& user,
 					const std::string& pwd,
@@ -182,34 +365,71 @@ namespace dss {
 			Config ExtractOptions(const SesOptions& opts);
 			Credentials& GetCredential() { return m_cred; }
 			Config& GetConfig() { return m_cfg; }
+			const SesOptions& GetOptions() { return m_opts; }
 
 			int GetObject(const Aws::String& objectName, const Aws::String& dest_fn);
-			PYBIND11_EXPORT int GetObjectNumpyBuffer(const Aws::String& objectName, py::array_t<uint8_t> numpy_buffer);
-			PYBIND11_EXPORT int GetObjectBuffer(const Aws::String& objectName, py::buffer buffer);
+			PYBIND11_EXPORT long long GetObjectNumpyBuffer(const Aws::String& objectName, py::array_t<uint8_t> numpy_buffer);
+			PYBIND11_EXPORT long long GetObjectBuffer(const Aws::String& objectName, py::buffer buffer);
+			PYBIND11_EXPORT long long GetObjectBuffers(const Aws::String& objectName, std::vector<py::buffer> buffers);
+			std::shared_ptr<PoolBuffer> GetObjectPooled(const Aws::String& objectName, long long size);
+			std::shared_ptr<PoolBuffer> GetObjectSized(const Aws::String& objectName);
+			int GetObjectMapped(const Aws::String& objectName, const Aws::String& dest_fn);
 			int GetObjectAsync(const std::string& objectName, const std::string& dst_fn,
 					Callback cb, void* cb_arg);
 			int PutObject(const Aws::String& objectName, const Aws::String& src_fn, bool async = false);
 			int PutObjectAsync(const std::string& objectName, const std::string& src_fn,
 					Callback cb = [](void* ptr, std::string key, std::string message, int err){},
 					void *cb_arg = nullptr);
-			PYBIND11_EXPORT int PutObjectBuffer(const Aws::String& objectName, py::buffer buffer, int content_length);
+			PYBIND11_EXPORT int PutObjectBuffer(const Aws::String& objectName, py::buffer buffer, long long content_length);
+			PYBIND11_EXPORT int PutObjectBuffers(const Aws::String& objectName, std::vector<py::buffer> buffers);
 			int DeleteObject(const Aws::String& objectName);
 			std::unique_ptr<Objects> GetObjects(std::string prefix, std::string delimiter,
 					bool comm_prefix = false,
-					uint32_t page_size = DSS_PAGINATION_DEFAULT);
-			std::set<std::string>&& ListObjects(const std::string& prefix, const std::string& delimiter);
+					uint32_t page_size = DSS_PAGINATION_DEFAULT,
+					uint32_t prefetch = 0,
+					const ListFilter& filter = ListFilter(),
+					uint32_t rank = 0, uint32_t world_size = 1);
+			KeyList ListObjects(const std::string& prefix, const std::string& delimiter,
+					unsigned int split = 0);
+			ObjectInfos ListObjectInfos(const std::string& prefix, const std::string& delimiter);
+			std::map<std::string, PrefixSummary> SummarizePrefix(const std::string& prefix,
+					const std::string& delimiter);
+			ObjectStat HeadObject(const std::string& key);
+			ObjectInfos HeadObjects(const std::vector<std::string>& keys);
+			std::unique_ptr<KeyIndex> BuildKeyIndex(const std::string& path, const std::string& prefix);
+			std::unique_ptr<KeyIndex> RefreshKeyIndex(const std::string& path);
+			static std::unique_ptr<KeyIndex> OpenKeyIndex(const std::string& path);
 			std::set<std::string> ListBuckets();
 
 		private:
 			Client(const std::string& url, const std::string& user, const std::string& pwd,
 					const SesOptions& opts);
 
+			std::shared_ptr<const KeyList> CachedClusterList(Cluster* c, const std::string& prefix,
+					const std::string& delimiter, bool comm_prefix);
+			ObjectInfos ListClusterInfos(Cluster* c, const std::string& prefix,
+					const std::string& delimiter, const std::string& start_after);
+			std::unique_ptr<KeyIndex> UpdateKeyIndex(const std::string& path,
+					const std::string& prefix, const KeyIndex* old);
+			KeyList ListClusterSplit(Cluster* c, const std::string& prefix,
+					const std::string& delimiter, unsigned int ways);
+			std::shared_ptr<FileSink> OpenFileSink(const std::string& path);
+			bool UseRanges(long long size);
+			bool UseMultipart(long long size);
+			Result GetObjectInto(Request* req, unsigned char* buf, long long size);
+			Result GetObjectRest(Request* req, unsigned char* buf, long long from, Result& first);
+			int GetObjectToMap(Request* req, Result& head, const unsigned char* first, long long got);
+
 			friend class Objects;
 			Credentials m_cred;
 			Config m_cfg;	
 
-			Endpoint* m_discover_ep;
-			ClusterMap* m_cluster_map;
+			std::string m_url;
+			SesOptions m_opts;
+			std::shared_ptr<Endpoint> m_discover_ep;
+			std::shared_ptr<ClusterMap> m_cluster_map;
+			long m_warmup_ms;
+			std::shared_ptr<BufferPool> m_pool;
 
 			// Bucket names can consist only of lowercase letters, numbers, dots (.), and hyphens
 			static constexpr char* LOCK_BUCKET = (char *)"dss-lock";
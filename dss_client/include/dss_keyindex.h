@@ -0,0 +1,143 @@
+/**
+  The Clear BSD License
+
+  Copyright (c) 2022 Samsung Electronics Co., Ltd.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted (subject to the limitations in the disclaimer
+  below) provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of Samsung Electronics Co., Ltd. nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+ NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#ifndef DSS_KEYINDEX_H
+#define DSS_KEYINDEX_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "dss_keylist.h"
+
+#define DSS_KEYINDEX_RESTART	16
+
+namespace dss {
+
+	/* Sorted listing of a prefix persisted to a file and read back
+	 * through mmap, so a job can start from the index instead of
+	 * re-listing the bucket.
+	 *
+	 * Keys are front-coded in blocks of DSS_KEYINDEX_RESTART, each block
+	 * starting with a full key for binary search. Sizes and mtimes are
+	 * plain int64 arrays, ETags are packed strings. Marks hold, per
+	 * cluster id, the last key listed from that cluster: a refresh only
+	 * lists what comes after them.
+	 *
+	 * Write() and Open() return -1 / nullptr with errno set on failure */
+	class KeyIndex {
+		public:
+			class const_iterator {
+				public:
+					typedef std::forward_iterator_tag iterator_category;
+					typedef std::string value_type;
+					typedef std::ptrdiff_t difference_type;
+					typedef const std::string* pointer;
+					typedef const std::string& reference;
+
+					const_iterator(const KeyIndex* idx, size_t i);
+					const std::string& operator*() const { return m_key; }
+					const_iterator& operator++();
+					bool operator==(const const_iterator& o) const { return m_idx == o.m_idx; }
+					bool operator!=(const const_iterator& o) const { return m_idx != o.m_idx; }
+				private:
+					void Decode();
+
+					const KeyIndex* m_index;
+					size_t m_idx;
+					const uint8_t* m_pos;
+					std::string m_key;
+			};
+
+			~KeyIndex();
+
+			/* infos must be sorted without duplicates. The file is written
+			 * next to path and renamed over it once complete */
+			static int Write(const std::string& path, const std::string& prefix,
+					const ObjectInfos& infos, const std::map<uint32_t, std::string>& marks);
+			static std::unique_ptr<KeyIndex> Open(const std::string& path);
+
+			size_t size() const { return m_count; }
+			std::string Get(size_t i) const;
+			int64_t Size(size_t i) const { return m_sizes[i]; }
+			int64_t MTime(size_t i) const { return m_mtimes[i]; }
+			std::string ETag(size_t i) const;
+			/* Index of key, -1 if it isn't in the index */
+			long long Find(const std::string& key) const;
+
+			const int64_t* Sizes() const { return m_sizes; }
+			const int64_t* MTimes() const { return m_mtimes; }
+			const std::string& Prefix() const { return m_prefix; }
+			const std::map<uint32_t, std::string>& Marks() const { return m_marks; }
+
+			/* Decode the whole index, e.g. to merge a refresh into it */
+			ObjectInfos Load() const;
+
+			const_iterator begin() const { return const_iterator(this, 0); }
+			const_iterator end() const { return const_iterator(this, m_count); }
+
+		private:
+			KeyIndex() :
+				m_map(nullptr),
+				m_map_len(0),
+				m_count(0),
+				m_restart(DSS_KEYINDEX_RESTART),
+				m_sizes(nullptr),
+				m_mtimes(nullptr),
+				m_etag_offs(nullptr),
+				m_etags(nullptr),
+				m_restarts(nullptr),
+				m_keys(nullptr) {}
+
+			bool Parse();
+			const uint8_t* Block(size_t b) const { return m_keys + m_restarts[b]; }
+
+			void* m_map;
+			size_t m_map_len;
+			size_t m_count;
+			size_t m_restart;
+			std::string m_prefix;
+			std::map<uint32_t, std::string> m_marks;
+			const int64_t* m_sizes;
+			const int64_t* m_mtimes;
+			const uint64_t* m_etag_offs;
+			const char* m_etags;
+			const uint64_t* m_restarts;
+			const uint8_t* m_keys;
+	};
+
+} // namespace dss
+
+#endif // DSS_KEYINDEX_H
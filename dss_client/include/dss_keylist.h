@@ -0,0 +1,181 @@
+/**
+  The Clear BSD License
+
+  Copyright (c) 2022 Samsung Electronics Co., Ltd.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted (subject to the limitations in the disclaimer
+  below) provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of Samsung Electronics Co., Ltd. nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+ NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#ifndef DSS_KEYLIST_H
+#define DSS_KEYLIST_H
+
+#include <stdint.h>
+#include <string.h>
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace dss {
+
+	/* Compact list of object keys: key bytes are packed back to back in
+	 * one arena and each key is an (offset, length) entry. Compared to a
+	 * std::set<std::string> that is one allocation per growth instead of
+	 * one per key, and 16 bytes of overhead per key (a padded Entry) instead
+	 * of ~80.
+	 *
+	 * Keys are appended in runs that are each sorted (one listing stream),
+	 * MergeRuns()/Merge() then order the entries without moving key bytes */
+	class KeyList {
+		public:
+			struct Entry {
+				uint64_t off;
+				uint32_t len;
+			};
+
+			class const_iterator {
+				public:
+					typedef std::forward_iterator_tag iterator_category;
+					typedef std::string value_type;
+					typedef std::ptrdiff_t difference_type;
+					typedef const std::string* pointer;
+					typedef std::string reference;
+
+					const_iterator(const KeyList* l, size_t i) : m_list(l), m_idx(i) {}
+					std::string operator*() const { return m_list->Get(m_idx); }
+					const_iterator& operator++() { m_idx++; return *this; }
+					bool operator==(const const_iterator& o) const { return m_idx == o.m_idx; }
+					bool operator!=(const const_iterator& o) const { return m_idx != o.m_idx; }
+				private:
+					const KeyList* m_list;
+					size_t m_idx;
+			};
+
+			void Append(const char* key, size_t len)
+			{
+				m_entries.push_back(Entry{m_arena.size(), (uint32_t)len});
+				m_arena.insert(m_arena.end(), key, key + len);
+			}
+			void Append(const std::string& key) { Append(key.data(), key.size()); }
+
+			/* Keys appended from now on form a new sorted run */
+			void BeginRun()
+			{
+				if (m_runs.empty() || m_runs.back() != m_entries.size())
+					m_runs.push_back(m_entries.size());
+			}
+			/* With order, order[i] is set to the index entry i had before */
+			void MergeRuns(bool dedup, std::vector<size_t>* order = nullptr);
+			/* Keep only entries order[0], order[1]... in that order */
+			void Select(const std::vector<size_t>& order);
+
+			/* Lists are moved into one, each becoming a run */
+			static KeyList Concat(std::vector<KeyList>& lists);
+			static KeyList Merge(std::vector<KeyList>& lists, bool dedup,
+					std::vector<size_t>* order = nullptr);
+
+			size_t size() const { return m_entries.size(); }
+			bool empty() const { return m_entries.empty(); }
+			void clear()
+			{
+				m_arena.clear();
+				m_entries.clear();
+				m_runs.clear();
+			}
+			void swap(KeyList& o)
+			{
+				m_arena.swap(o.m_arena);
+				m_entries.swap(o.m_entries);
+				m_runs.swap(o.m_runs);
+			}
+
+			const char* Data(size_t i) const { return m_arena.data() + m_entries[i].off; }
+			uint32_t Length(size_t i) const { return m_entries[i].len; }
+			std::string Get(size_t i) const { return std::string(Data(i), Length(i)); }
+			/* Bytes held by the list, keys plus index */
+			size_t Footprint() const
+			{
+				return m_arena.capacity() + m_entries.capacity() * sizeof(Entry);
+			}
+
+			/* Byte-wise order, same as S3 listing order */
+			static int Compare(const char* a, size_t alen, const char* b, size_t blen)
+			{
+				int r = memcmp(a, b, alen < blen ? alen : blen);
+				if (r)
+					return r;
+				return alen < blen ? -1 : (alen > blen ? 1 : 0);
+			}
+
+			const_iterator begin() const { return const_iterator(this, 0); }
+			const_iterator end() const { return const_iterator(this, m_entries.size()); }
+
+		private:
+			std::vector<char> m_arena;
+			std::vector<Entry> m_entries;
+			std::vector<size_t> m_runs;
+	};
+
+	/* Listing with object metadata, one column per field so that sizes
+	 * and mtimes can be handed out as plain arrays. Row i of each column
+	 * describes keys[i]. ETags are kept without the quotes */
+	class ObjectInfos {
+		public:
+			void Append(const std::string& key, int64_t size, const std::string& etag,
+					int64_t mtime_ms)
+			{
+				keys.Append(key);
+				sizes.push_back(size);
+				etags.Append(etag);
+				mtimes.push_back(mtime_ms);
+			}
+			void BeginRun() { keys.BeginRun(); }
+			void MergeRuns(bool dedup);
+
+			static ObjectInfos Merge(std::vector<ObjectInfos>& lists, bool dedup);
+
+			size_t size() const { return keys.size(); }
+			void clear()
+			{
+				keys.clear();
+				sizes.clear();
+				etags.clear();
+				mtimes.clear();
+			}
+
+			KeyList keys;
+			std::vector<int64_t> sizes;
+			KeyList etags;
+			std::vector<int64_t> mtimes;
+
+		private:
+			void Select(const std::vector<size_t>& order);
+	};
+
+} // namespace dss
+
+#endif // DSS_KEYLIST_H
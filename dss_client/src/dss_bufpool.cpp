@@ -0,0 +1,249 @@
+/**
+  The Clear BSD License
+
+  Copyright (c) 2022 Samsung Electronics Co., Ltd.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted (subject to the limitations in the disclaimer
+  below) provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of Samsung Electronics Co., Ltd. nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+ NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <algorithm>
+
+#include "dss_bufpool.h"
+
+namespace dss {
+
+	PoolBuffer::PoolBuffer(std::weak_ptr<BufferPool> pool, unsigned char* data, size_t cap, int cls) :
+		m_pool(pool),
+		m_data(data),
+		m_cap(cap),
+		m_size(0),
+		m_cls(cls)
+	{
+	}
+
+	PoolBuffer::~PoolBuffer()
+	{
+		std::shared_ptr<BufferPool> pool = m_pool.lock();
+
+		if (pool)
+			pool->Put(m_data, m_cap, m_cls);
+		else
+			munmap(m_data, m_cap);
+	}
+
+	BufferPool::BufferPool(size_t max_size, unsigned per_class, bool hugepages) :
+		m_max(0),
+		m_per_class(per_class),
+		m_huge(hugepages)
+	{
+		for (size_t cap = DSS_BUFPOOL_MIN_CLASS; cap <= max_size; cap <<= 1) {
+			m_free.emplace_back();
+			m_max = cap;
+		}
+	}
+
+	BufferPool::~BufferPool()
+	{
+		for (size_t cls = 0; cls < m_free.size(); cls++)
+			for (auto p : m_free[cls])
+				munmap(p, DSS_BUFPOOL_MIN_CLASS << cls);
+	}
+
+	/* Pages are populated up front, the pool pays the faults once per
+	 * buffer instead of once per use */
+	unsigned char*
+		BufferPool::Map(size_t len)
+		{
+			int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE;
+			void* p = MAP_FAILED;
+
+			if (m_huge && len % DSS_HUGEPAGE_SIZE == 0)
+				p = mmap(nullptr, len, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+			if (p == MAP_FAILED) {
+				if (m_huge && len >= DSS_HUGEPAGE_SIZE) {
+					p = mmap(nullptr, len, PROT_READ | PROT_WRITE, flags & ~MAP_POPULATE, -1, 0);
+					if (p != MAP_FAILED) {
+						(void)madvise(p, len, MADV_HUGEPAGE);
+						(void)madvise(p, len, MADV_WILLNEED);
+					}
+				} else {
+					p = mmap(nullptr, len, PROT_READ | PROT_WRITE, flags, -1, 0);
+				}
+			}
+
+			return p == MAP_FAILED ? nullptr : (unsigned char*)p;
+		}
+
+	std::shared_ptr<PoolBuffer>
+		BufferPool::Get(size_t size)
+		{
+			unsigned char* data = nullptr;
+			size_t cap = DSS_BUFPOOL_MIN_CLASS;
+			int cls = 0;
+
+			// Pooling is off below the smallest class, mmap() refuses zero length
+			if (m_free.empty() || size > m_max) {
+				size_t page = m_huge ? DSS_HUGEPAGE_SIZE : 4096;
+				cap = std::max<size_t>((size + page - 1) / page * page, page);
+				cls = -1;
+			} else {
+				while (cap < size) {
+					cap <<= 1;
+					cls++;
+				}
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (!m_free[cls].empty()) {
+					data = m_free[cls].back();
+					m_free[cls].pop_back();
+				}
+			}
+
+			if (!data && !(data = Map(cap)))
+				return nullptr;
+
+			return std::shared_ptr<PoolBuffer>(new PoolBuffer(shared_from_this(), data, cap, cls));
+		}
+
+	void
+		BufferPool::Put(unsigned char* data, size_t cap, int cls)
+		{
+			if (cls >= 0) {
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_free[cls].size() < m_per_class) {
+					m_free[cls].push_back(data);
+					return;
+				}
+			}
+			munmap(data, cap);
+		}
+
+	size_t
+		BufferPool::Idle()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			size_t n = 0;
+
+			for (auto& f : m_free)
+				n += f.size();
+
+			return n;
+		}
+
+	PoolSink::PoolSink(std::shared_ptr<BufferPool> pool) :
+		m_pool(pool)
+	{
+	}
+
+	/* pbump() takes an int, bodies may be larger */
+	void
+		PoolSink::Bump(size_t n)
+		{
+			for (; n > INT_MAX; n -= INT_MAX)
+				pbump(INT_MAX);
+			pbump(n);
+		}
+
+	bool
+		PoolSink::Reserve(size_t size)
+		{
+			size_t used = Written();
+
+			if (m_buf && size <= m_buf->Capacity())
+				return true;
+
+			std::shared_ptr<PoolBuffer> buf = m_pool->Get(size);
+			if (!buf)
+				return false;
+			if (used)
+				memcpy(buf->Data(), m_buf->Data(), used);
+
+			m_buf = buf;
+			char* base = (char*)m_buf->Data();
+			setp(base, base + m_buf->Capacity());
+			Bump(used);
+
+			return true;
+		}
+
+	void
+		PoolSink::Reset()
+		{
+			if (m_buf) {
+				char* base = (char*)m_buf->Data();
+				setp(base, base + m_buf->Capacity());
+			}
+		}
+
+	std::shared_ptr<PoolBuffer>
+		PoolSink::Take()
+		{
+			size_t used = Written();
+
+			// Nothing came, e.g. an empty object
+			if (!m_buf && !(m_buf = m_pool->Get(0)))
+				return nullptr;
+
+			m_buf->SetSize(used);
+			setp(nullptr, nullptr);
+
+			return std::move(m_buf);
+		}
+
+	PoolSink::int_type
+		PoolSink::overflow(int_type c)
+		{
+			if (!Reserve(std::max<size_t>(DSS_BUFPOOL_MIN_CLASS, 2 * Written())))
+				return traits_type::eof();
+
+			if (!traits_type::eq_int_type(c, traits_type::eof())) {
+				*pptr() = traits_type::to_char_type(c);
+				pbump(1);
+			}
+
+			return traits_type::not_eof(c);
+		}
+
+	std::streamsize
+		PoolSink::xsputn(const char* s, std::streamsize n)
+		{
+			size_t used = Written();
+
+			if ((size_t)(epptr() - pptr()) < (size_t)n &&
+					!Reserve(std::max<size_t>(used + n, 2 * used)))
+				return 0;
+
+			memcpy(pptr(), s, n);
+			Bump(n);
+
+			return n;
+		}
+
+} // namespace dss
@@ -0,0 +1,132 @@
+/**
+  The Clear BSD License
+
+  Copyright (c) 2022 Samsung Electronics Co., Ltd.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted (subject to the limitations in the disclaimer
+  below) provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of Samsung Electronics Co., Ltd. nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+ NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#ifndef DSS_BUFPOOL_H
+#define DSS_BUFPOOL_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <vector>
+
+#define DSS_BUFPOOL_MIN_CLASS	(64UL << 10)
+#define DSS_HUGEPAGE_SIZE		(2UL << 20)
+
+namespace dss {
+
+	class BufferPool;
+
+	/* Buffer taken from a BufferPool, handed back to it on destruction
+	 * (or unmapped if the pool is gone or full). Size() is how much of
+	 * it holds data */
+	class PoolBuffer {
+		public:
+			~PoolBuffer();
+
+			unsigned char* Data() { return m_data; }
+			size_t Capacity() const { return m_cap; }
+			size_t Size() const { return m_size; }
+			void SetSize(size_t size) { m_size = size; }
+
+		private:
+			friend class BufferPool;
+			PoolBuffer(std::weak_ptr<BufferPool> pool, unsigned char* data, size_t cap, int cls);
+
+			std::weak_ptr<BufferPool> m_pool;
+			unsigned char* m_data;
+			size_t m_cap;
+			size_t m_size;
+			int m_cls;
+	};
+
+	/* Page-aligned, pre-faulted buffers in power-of-two size classes from
+	 * DSS_BUFPOOL_MIN_CLASS up to max_size. Released buffers are kept for
+	 * reuse, up to per_class of each class, so a steady stream of GETs
+	 * neither allocates nor faults pages in. Larger requests get a buffer
+	 * of their own, unmapped on release.
+	 *
+	 * With hugepages, buffers of 2 MiB and up come from hugetlbfs when
+	 * pages are reserved, else as transparent huge pages */
+	class BufferPool : public std::enable_shared_from_this<BufferPool> {
+		public:
+			BufferPool(size_t max_size, unsigned per_class, bool hugepages);
+			~BufferPool();
+
+			/* Buffer of at least size bytes, nullptr with errno set on failure */
+			std::shared_ptr<PoolBuffer> Get(size_t size);
+			/* Free buffers currently kept */
+			size_t Idle();
+
+		private:
+			friend class PoolBuffer;
+			void Put(unsigned char* data, size_t cap, int cls);
+			unsigned char* Map(size_t len);
+
+			size_t m_max;
+			unsigned m_per_class;
+			bool m_huge;
+			std::mutex m_mutex;
+			std::vector<std::vector<unsigned char*>> m_free;
+	};
+
+	/* Response body received into one buffer from a pool. Reserve() it
+	 * at the Content-Length and the body lands in a buffer of the right
+	 * class with no copy. Without a reservation (or past it) the buffer
+	 * grows by doubling, copying what was received so far */
+	class PoolSink : public std::streambuf {
+		public:
+			PoolSink(std::shared_ptr<BufferPool> pool);
+
+			/* Room for size bytes in all, false with errno set on failure */
+			bool Reserve(size_t size);
+			/* Start over, for a retried request */
+			void Reset();
+			/* The received body, sized to it */
+			std::shared_ptr<PoolBuffer> Take();
+
+		protected:
+			int_type overflow(int_type c) override;
+			std::streamsize xsputn(const char* s, std::streamsize n) override;
+
+		private:
+			size_t Written() { return m_buf ? pptr() - pbase() : 0; }
+			void Bump(size_t n);
+
+			std::shared_ptr<BufferPool> m_pool;
+			std::shared_ptr<PoolBuffer> m_buf;
+	};
+
+} // namespace dss
+
+#endif // DSS_BUFPOOL_H
@@ -0,0 +1,192 @@
+/**
+  The Clear BSD License
+
+  Copyright (c) 2022 Samsung Electronics Co., Ltd.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted (subject to the limitations in the disclaimer
+  below) provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of Samsung Electronics Co., Ltd. nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+ NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dss_bufpool.h"
+
+using dss::BufferPool;
+using dss::PoolBuffer;
+using dss::PoolSink;
+
+static void
+test_classes()
+{
+	auto pool = std::make_shared<BufferPool>(1 << 20, 2, false);
+
+	auto a = pool->Get(1);
+	assert(a->Capacity() == DSS_BUFPOOL_MIN_CLASS);
+	assert((uintptr_t)a->Data() % 4096 == 0);
+	auto b = pool->Get(DSS_BUFPOOL_MIN_CLASS + 1);
+	assert(b->Capacity() == 2 * DSS_BUFPOOL_MIN_CLASS);
+	auto c = pool->Get(1 << 20);
+	assert(c->Capacity() == 1 << 20);
+	// Past the largest class, exact pages
+	auto d = pool->Get((1 << 20) + 1);
+	assert(d->Capacity() == (1 << 20) + 4096);
+	memset(d->Data(), 1, d->Capacity());
+
+	a.reset();
+	b.reset();
+	c.reset();
+	d.reset();
+	assert(pool->Idle() == 3);
+}
+
+/* Released buffers are reused, up to per_class of them are kept */
+static void
+test_reuse()
+{
+	auto pool = std::make_shared<BufferPool>(1 << 20, 2, false);
+	std::vector<std::shared_ptr<PoolBuffer>> held;
+
+	auto a = pool->Get(100);
+	unsigned char* p = a->Data();
+	a.reset();
+	a = pool->Get(1000);
+	assert(a->Data() == p);
+	a.reset();
+
+	for (int i = 0; i < 5; i++)
+		held.push_back(pool->Get(100));
+	held.clear();
+	assert(pool->Idle() == 2);
+}
+
+/* Buffers may outlive their pool, e.g. held by Python after the client */
+static void
+test_orphan()
+{
+	auto pool = std::make_shared<BufferPool>(1 << 20, 2, true);
+	auto a = pool->Get(3 << 20);
+	auto b = pool->Get(100);
+
+	assert(a->Capacity() == 4 << 20);
+	memset(a->Data(), 1, a->Capacity());
+	pool.reset();
+	a->Data()[0] = 2;
+	b->Data()[0] = 2;
+}
+
+/* A pool below the smallest class never pools, empty requests included */
+static void
+test_disabled()
+{
+	for (size_t max : {(size_t)0, DSS_BUFPOOL_MIN_CLASS - 1}) {
+		auto pool = std::make_shared<BufferPool>(max, 32, false);
+		for (size_t size : {0, 1, 100000}) {
+			auto b = pool->Get(size);
+			assert(b && b->Capacity() >= std::max<size_t>(size, 1));
+			b->Data()[0] = 1;
+		}
+		assert(pool->Idle() == 0);
+	}
+}
+
+static void
+test_threads()
+{
+	auto pool = std::make_shared<BufferPool>(4 << 20, 8, false);
+	std::vector<std::thread> ts;
+
+	for (int t = 0; t < 8; t++)
+		ts.emplace_back([pool, t]() {
+				for (int i = 0; i < 1000; i++) {
+					auto b = pool->Get((i * 7919 + t) % (4 << 20));
+					b->Data()[0] = t;
+					b->SetSize(1);
+				}
+				});
+	for (auto& t : ts)
+		t.join();
+	assert(pool->Idle() <= 8 * 7);
+}
+
+/* Reserved at the right size, grown from nothing, retried, empty */
+static void
+test_sink()
+{
+	auto pool = std::make_shared<BufferPool>(1 << 20, 4, false);
+	std::mt19937 rng(1);
+
+	for (size_t size : {0, 1, 70000, 3 << 20}) {
+		std::string body(size, 0);
+		for (auto& c : body)
+			c = rng();
+
+		for (bool reserve : {false, true}) {
+			PoolSink sink(pool);
+			std::ostream os(&sink);
+
+			if (reserve)
+				assert(sink.Reserve(size));
+			os.write("garbage", 7);
+			sink.Reset();
+			for (size_t off = 0; off < size; ) {
+				size_t n = std::min<size_t>(size - off, rng() % 20000);
+				if (n == 1)
+					os.put(body[off]);
+				else
+					os.write(&body[off], n);
+				off += n;
+			}
+			assert(os.good());
+
+			std::shared_ptr<PoolBuffer> buf = sink.Take();
+			assert(buf->Size() == size);
+			assert(std::string((char*)buf->Data(), size) == body);
+			if (reserve && size > DSS_BUFPOOL_MIN_CLASS)
+				assert(buf->Capacity() < 2 * size);
+		}
+	}
+}
+
+int main()
+{
+	test_classes();
+	test_reuse();
+	test_orphan();
+	test_disabled();
+	test_threads();
+	test_sink();
+
+	printf("bufpool: all tests passed\n");
+
+	return 0;
+}
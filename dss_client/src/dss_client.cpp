@@ -37,6 +37,8 @@
 #include <mutex>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <fnmatch.h>
 #include <bits/stdc++.h>
 #include <linux/limits.h>
 
@@ -47,7 +49,14 @@
 
 #include <aws/s3/S3Client.h>
 #include <aws/s3/model/GetObjectRequest.h>
+#include <aws/s3/model/HeadObjectRequest.h>
 #include <aws/s3/model/PutObjectRequest.h>
+#include <aws/s3/model/CreateMultipartUploadRequest.h>
+#include <aws/s3/model/UploadPartRequest.h>
+#include <aws/s3/model/CompleteMultipartUploadRequest.h>
+#include <aws/s3/model/CompletedMultipartUpload.h>
+#include <aws/s3/model/CompletedPart.h>
+#include <aws/s3/model/AbortMultipartUploadRequest.h>
 #include <aws/s3/model/DeleteObjectRequest.h>
 #include <aws/s3/model/ListObjectsV2Request.h>
 #include <aws/s3/model/CreateBucketRequest.h>
@@ -56,6 +65,11 @@
 #include <aws/s3/model/BucketLocationConstraint.h>
 #include <aws/s3/model/CommonPrefix.h>
 #include <aws/core/utils/stream/PreallocatedStreamBuf.h>
+#include <aws/core/http/HttpClientFactory.h>
+#include <aws/core/http/curl/CurlHttpClient.h>
+#include <aws/core/http/standard/StandardHttpRequest.h>
+#include <aws/core/http/HttpResponse.h>
+#include <curl/curl.h>
 
 
 #include "dss.h"
@@ -71,23 +85,172 @@ namespace dss {
 
 	static const char* DSS_ALLOC_TAG = "DSS";
 
+	/* S3 returns ETags in double quotes */
+	static std::string
+		Unquote(const Aws::String& etag)
+		{
+			size_t q = etag.size() >= 2 && etag.front() == '"' && etag.back() == '"' ? 1 : 0;
+
+			return std::string(etag.c_str() + q, etag.size() - 2 * q);
+		}
+
 	DSSInit dss_init;
+	SessionRegistry session_registry;
+
+	/* Hold the init and registry mutexes across fork() so that a child
+	 * never inherits them locked by a thread that doesn't exist there */
+	void DSSInit::AtForkPrepare()
+	{
+		session_registry.mutex().lock();
+		dss_init.m_mutex.lock();
+	}
+
+	void DSSInit::AtForkParent()
+	{
+		dss_init.m_mutex.unlock();
+		session_registry.mutex().unlock();
+	}
+
+	void DSSInit::AtForkChild()
+	{
+		dss_init.m_mutex.unlock();
+		session_registry.ForkChild();
+		session_registry.mutex().unlock();
+		dss_init.m_fork_gen++;
+	}
+
+	static thread_local const std::string* bind_iface = nullptr;
+
+	class BoundCurlHttpClient : public Aws::Http::CurlHttpClient {
+		public:
+			BoundCurlHttpClient(const Aws::Client::ClientConfiguration& cfg,
+					const std::string& iface) :
+				Aws::Http::CurlHttpClient(cfg), m_iface(iface) {}
+
+		protected:
+			void OverrideOptionsOnConnectionHandle(CURL* handle) const override
+			{
+				curl_easy_setopt(handle, CURLOPT_INTERFACE, m_iface.c_str());
+			}
+
+		private:
+			std::string m_iface;
+	};
+
+	std::shared_ptr<Aws::Http::HttpClient>
+		DSSHttpClientFactory::CreateHttpClient(const Aws::Client::ClientConfiguration& cfg) const
+		{
+			if (bind_iface && !bind_iface->empty())
+				return Aws::MakeShared<BoundCurlHttpClient>(DSS_ALLOC_TAG, cfg, *bind_iface);
+
+			return Aws::MakeShared<Aws::Http::CurlHttpClient>(DSS_ALLOC_TAG, cfg);
+		}
+
+	std::shared_ptr<Aws::Http::HttpRequest>
+		DSSHttpClientFactory::CreateHttpRequest(const Aws::String& uri, Aws::Http::HttpMethod method,
+				const Aws::IOStreamFactory& factory) const
+		{
+			return CreateHttpRequest(Aws::Http::URI(uri), method, factory);
+		}
+
+	std::shared_ptr<Aws::Http::HttpRequest>
+		DSSHttpClientFactory::CreateHttpRequest(const Aws::Http::URI& uri, Aws::Http::HttpMethod method,
+				const Aws::IOStreamFactory& factory) const
+		{
+			auto req = Aws::MakeShared<Aws::Http::Standard::StandardHttpRequest>(DSS_ALLOC_TAG, uri, method);
+			req->SetResponseStreamFactory(factory);
+
+			return req;
+		}
+
+	void
+		DSSHttpClientFactory::InitStaticState()
+		{
+			Aws::Http::CurlHttpClient::InitGlobalState();
+		}
+
+	void
+		DSSHttpClientFactory::CleanupStaticState()
+		{
+			Aws::Http::CurlHttpClient::CleanupGlobalState();
+		}
+
+	ScopedInterfaceBinding::ScopedInterfaceBinding(const std::string& iface)
+	{
+		bind_iface = &iface;
+	}
 
+	ScopedInterfaceBinding::~ScopedInterfaceBinding()
+	{
+		bind_iface = nullptr;
+	}
 
-	Endpoint::Endpoint(Aws::Auth::AWSCredentials& cred, const std::string& url, Config& cfg) 
+	Endpoint::Endpoint(Aws::Auth::AWSCredentials& cred, const std::string& url, Config& cfg,
+			const std::vector<std::string>& ifaces) :
+		m_cred(cred),
+		m_ifaces(ifaces),
+		m_next_ses(0),
+		m_fork_gen(dss_init.ForkGeneration())
 	{
 		cfg.endpointOverride = url.c_str();
-		m_ses = Aws::S3::S3Client(cred, cfg, 
-				Aws::Client::AWSAuthV4Signer::PayloadSigningPolicy::Never, false);
+		m_cfg = cfg;
+		Connect();
 	}
 
+	void
+		Endpoint::Connect()
+		{
+			if (m_ifaces.empty()) {
+				m_ses.emplace_back(new Aws::S3::S3Client(m_cred, m_cfg,
+							Aws::Client::AWSAuthV4Signer::PayloadSigningPolicy::Never, false));
+				return;
+			}
+
+			for (auto& iface : m_ifaces) {
+				ScopedInterfaceBinding bind(iface);
+				m_ses.emplace_back(new Aws::S3::S3Client(m_cred, m_cfg,
+							Aws::Client::AWSAuthV4Signer::PayloadSigningPolicy::Never, false));
+				pr_debug("Endpoint %s via %s\n", m_cfg.endpointOverride.c_str(), iface.c_str());
+			}
+		}
+
+	/* Endpoints (and the cluster map holding them) may be created once
+	 * in a parent and used from forked workers. The curl handles in the
+	 * inherited session share sockets with the parent, so each child
+	 * builds its own session on first use */
+	Aws::S3::S3Client&
+		Endpoint::Session()
+		{
+			unsigned gen = dss_init.ForkGeneration();
+
+			if (m_fork_gen.load() != gen) {
+				std::lock_guard<std::mutex> lock(m_ses_mutex);
+				if (m_fork_gen.load() != gen) {
+					// Intentionally leaked: destroying them would shut down
+					// connections that still belong to the parent
+					for (auto& ses : m_ses)
+						ses.release();
+					m_ses.clear();
+					Connect();
+					m_fork_gen.store(gen);
+					pr_debug("Rebuilt session to %s in pid %d\n",
+							m_cfg.endpointOverride.c_str(), getpid());
+				}
+			}
+
+			if (m_ses.size() == 1)
+				return *m_ses[0];
+
+			return *m_ses[m_next_ses++ % m_ses.size()];
+		}
+
 	Result
 		Endpoint::HeadBucket(const Aws::String& bucket)
 		{
 			Aws::S3::Model::HeadBucketRequest req;
 			req.SetBucket(bucket);
 
-			auto&& out = m_ses.HeadBucket(req);
+			auto&& out = Session().HeadBucket(req);
 
 			if (out.IsSuccess())
 				return Result(true);
@@ -101,7 +264,7 @@ namespace dss {
 			Aws::S3::Model::CreateBucketRequest request;
 			request.SetBucket(bn);
 
-			auto out = m_ses.CreateBucket(request);
+			auto out = Session().CreateBucket(request);
 
 			if (out.IsSuccess())
 				return Result(true);
@@ -115,7 +278,7 @@ namespace dss {
 			Aws::S3::Model::DeleteBucketRequest request;
 			request.SetBucket(bn);
 
-			auto out = m_ses.DeleteBucket(request);
+			auto out = Session().DeleteBucket(request);
 
 			if (out.IsSuccess())
 				return Result(true);
@@ -123,13 +286,34 @@ namespace dss {
 				return Result(false, out.GetError());
 		}
 
+	/* The body goes straight into the request's file sink. The factory
+	 * runs again on every SDK retry, so the sink starts over each time */
+	static void
+		SetFileSink(Aws::S3::Model::GetObjectRequest& ep_req, std::shared_ptr<FileSink> sink)
+		{
+			ep_req.SetResponseStreamFactory([sink]() {
+					sink->Reset();
+					return Aws::New<Aws::IOStream>(DSS_ALLOC_TAG, sink.get());
+					});
+			ep_req.SetHeadersReceivedEventHandler([sink](const Aws::Http::HttpRequest*,
+						Aws::Http::HttpResponse* resp) {
+					if (resp->GetResponseCode() != Aws::Http::HttpResponseCode::OK)
+						return;
+					const Aws::String& len = resp->GetHeader("content-length");
+					if (!len.empty())
+						sink->Preallocate(std::strtoll(len.c_str(), nullptr, 10));
+					});
+		}
+
 	Result
 		Endpoint::GetObject(const Aws::String& bn, Request* req)
 		{
 			Aws::S3::Model::GetObjectRequest ep_req;
 			ep_req.WithBucket(bn).SetKey(Aws::String(req->key.c_str()));
+			if (req->sink)
+				SetFileSink(ep_req, req->sink);
 
-			Aws::S3::Model::GetObjectOutcome out = m_ses.GetObject(ep_req);
+			Aws::S3::Model::GetObjectOutcome out = Session().GetObject(ep_req);
 
 			if (out.IsSuccess()) {
 				return Result(true, out.GetResultWithOwnership());
@@ -145,7 +329,7 @@ namespace dss {
 			Aws::S3::Model::GetObjectRequest req;
 			req.WithBucket(bn).SetKey(objectName);
 
-			Aws::S3::Model::GetObjectOutcome out = m_ses.GetObject(req);
+			Aws::S3::Model::GetObjectOutcome out = Session().GetObject(req);
 
 			if (out.IsSuccess()) {
 				return Result(true, out.GetResultWithOwnership());
@@ -161,7 +345,7 @@ namespace dss {
 			ep_req.WithBucket(bn).SetKey(Aws::String(req->key.c_str()));
 			Aws::Utils::Stream::PreallocatedStreamBuf streambuf(res_buff, buffer_size);
 			ep_req.SetResponseStreamFactory([&streambuf]() { return Aws::New<Aws::IOStream>("", &streambuf); });
-			Aws::S3::Model::GetObjectOutcome out = m_ses.GetObject(ep_req);
+			Aws::S3::Model::GetObjectOutcome out = Session().GetObject(ep_req);
 			if (out.IsSuccess()) {
 				return Result(true, out.GetResultWithOwnership().GetContentLength());
 			} else {
@@ -169,6 +353,122 @@ namespace dss {
 			}
 		}
 
+	Result
+		Endpoint::HeadObject(const Aws::String& bn, Request* req)
+		{
+			Aws::S3::Model::HeadObjectRequest ep_req;
+			ep_req.WithBucket(bn).SetKey(Aws::String(req->key.c_str()));
+
+			Aws::S3::Model::HeadObjectOutcome out = Session().HeadObject(ep_req);
+			if (out.IsSuccess())
+				return Result(true, out.GetResult().GetContentLength(), out.GetResult().GetETag(),
+						out.GetResult().GetLastModified().Millis());
+			else
+				return Result(false, out.GetError());
+		}
+
+	/* The body fills the segments in order, a retry starts over */
+	Result
+		Endpoint::GetObjectSegments(const Aws::String& bn, Request* req, SegmentStreamBuf* sb)
+		{
+			Aws::S3::Model::GetObjectRequest ep_req;
+			ep_req.WithBucket(bn).SetKey(Aws::String(req->key.c_str()));
+			ep_req.SetResponseStreamFactory([sb]() {
+					sb->pubseekpos(0, std::ios_base::out);
+					return Aws::New<Aws::IOStream>(DSS_ALLOC_TAG, sb);
+					});
+
+			Aws::S3::Model::GetObjectOutcome out = Session().GetObject(ep_req);
+			if (out.IsSuccess())
+				return Result(true, out.GetResult().GetContentLength());
+			else
+				return Result(false, out.GetError());
+		}
+
+	/* The sink allocates its buffer at the Content-Length, once the
+	 * headers are in and before the first body bytes */
+	Result
+		Endpoint::GetObjectSized(const Aws::String& bn, Request* req, PoolSink* sink)
+		{
+			Aws::S3::Model::GetObjectRequest ep_req;
+			ep_req.WithBucket(bn).SetKey(Aws::String(req->key.c_str()));
+			ep_req.SetResponseStreamFactory([sink]() {
+					sink->Reset();
+					return Aws::New<Aws::IOStream>(DSS_ALLOC_TAG, sink);
+					});
+			ep_req.SetHeadersReceivedEventHandler([sink](const Aws::Http::HttpRequest*,
+						Aws::Http::HttpResponse* resp) {
+					if (resp->GetResponseCode() != Aws::Http::HttpResponseCode::OK)
+						return;
+					const Aws::String& len = resp->GetHeader("content-length");
+					if (!len.empty())
+						sink->Reserve(std::strtoull(len.c_str(), nullptr, 10));
+					});
+
+			Aws::S3::Model::GetObjectOutcome out = Session().GetObject(ep_req);
+			if (out.IsSuccess())
+				return Result(true, out.GetResult().GetContentLength());
+			else
+				return Result(false, out.GetError());
+		}
+
+	/* Bytes [off, off + len) of the object into buf, failing if the
+	 * object no longer has the given ETag */
+	Result
+		Endpoint::GetObjectRange(const Aws::String& bn, Request* req, unsigned char* buf,
+				long long off, long long len, const Aws::String& etag)
+		{
+			Aws::S3::Model::GetObjectRequest ep_req;
+			std::string range = "bytes=" + std::to_string(off) + "-" + std::to_string(off + len - 1);
+
+			ep_req.WithBucket(bn).SetKey(Aws::String(req->key.c_str()));
+			ep_req.SetRange(Aws::String(range.c_str()));
+			if (!etag.empty())
+				ep_req.SetIfMatch(etag);
+			Aws::Utils::Stream::PreallocatedStreamBuf streambuf(buf, len);
+			ep_req.SetResponseStreamFactory([&streambuf]() { return Aws::New<Aws::IOStream>("", &streambuf); });
+
+			Aws::S3::Model::GetObjectOutcome out = Session().GetObject(ep_req);
+			if (out.IsSuccess())
+				return Result(true, out.GetResult().GetContentLength());
+			else
+				return Result(false, out.GetError());
+		}
+
+	/* Up to len first bytes of the object into buf, in place of a HEAD:
+	 * the result carries the object's size, from Content-Range, and its
+	 * ETag. An empty object has no range to satisfy and comes back empty */
+	Result
+		Endpoint::GetObjectFirstPart(const Aws::String& bn, Request* req, unsigned char* buf,
+				long long len)
+		{
+			Aws::S3::Model::GetObjectRequest ep_req;
+			std::string range = "bytes=0-" + std::to_string(len - 1);
+
+			ep_req.WithBucket(bn).SetKey(Aws::String(req->key.c_str()));
+			ep_req.SetRange(Aws::String(range.c_str()));
+			Aws::Utils::Stream::PreallocatedStreamBuf streambuf(buf, len);
+			ep_req.SetResponseStreamFactory([&streambuf]() { return Aws::New<Aws::IOStream>("", &streambuf); });
+
+			Aws::S3::Model::GetObjectOutcome out = Session().GetObject(ep_req);
+			if (out.IsSuccess()) {
+				// "bytes 0-N/SIZE", or no range if the server sent it all
+				const Aws::String& cr = out.GetResult().GetContentRange();
+				size_t slash = cr.find('/');
+				long long size = out.GetResult().GetContentLength();
+
+				if (slash != Aws::String::npos && cr.compare(slash + 1, Aws::String::npos, "*"))
+					size = std::strtoll(cr.c_str() + slash + 1, nullptr, 10);
+
+				return Result(true, size, out.GetResult().GetETag());
+			} else if (out.GetError().GetResponseCode() ==
+					Aws::Http::HttpResponseCode::REQUESTED_RANGE_NOT_SATISFIABLE) {
+				return Result(true, 0, Aws::String());
+			} else {
+				return Result(false, out.GetError());
+			}
+		}
+
 	void GetObjectAsyncDone(const Aws::S3::S3Client* s3Client, 
 			const Aws::S3::Model::GetObjectRequest& request, 
 			const Aws::S3::Model::GetObjectOutcome& outcome,
@@ -177,25 +477,23 @@ namespace dss {
 		const std::shared_ptr<const CallbackCtx> ctx = 
 			std::static_pointer_cast<const CallbackCtx>(context);
 
+		Request* req = (Request*)ctx->getCbArgs();
+
 		if (outcome.IsSuccess()) {
 			Callback cb = ctx->getCbFunc();
-			Request* req = (Request*)ctx->getCbArgs();
-
-			std::fstream local_file;
-			local_file.open(req->file.c_str(), std::ios::out | std::ios::binary);
-			auto& aws_result = outcome.GetResult();
-			auto& object_stream = const_cast<Aws::S3::Model::GetObjectResult&>(aws_result).GetBody();
-
-			//TODO: revist performance
-			local_file << object_stream.rdbuf();
-			local_file.flush();
-			local_file.close();
 
-			cb(req->done_arg, req->key,
-					outcome.GetError().GetMessage().c_str(), 0);
+			if (req->sink->Commit() < 0) {
+				std::string err = "Path " + req->file + ": " + strerror(errno);
+				cb(req->done_arg, req->key, err.c_str(), -1);
+			} else {
+				cb(req->done_arg, req->key,
+						outcome.GetError().GetMessage().c_str(), 0);
+			}
 		} else {
-			std::cout << "Error: PutObjectAsyncDone: " <<
+			std::cout << "Error: GetObjectAsyncDone: " <<
 				outcome.GetError().GetMessage() << std::endl;
+			// Drops the partial download
+			req->sink.reset();
 		}
 
 		//upload_variable.notify_one();
@@ -206,6 +504,7 @@ namespace dss {
 		{
 			Aws::S3::Model::GetObjectRequest request;
 			request.WithBucket(bn).SetKey(Aws::String(req->key.c_str()));
+			SetFileSink(request, req->sink);
 
 			// Create and configure the context for the asynchronous put object request.
 			std::shared_ptr<Aws::Client::AsyncCallerContext> context =
@@ -215,11 +514,74 @@ namespace dss {
 			// Make the asynchronous put object call. Queue the request into a 
 			// thread executor and call the GetObjectAsyncDone function when the 
 			// operation has finished. 
-			m_ses.GetObjectAsync(request, GetObjectAsyncDone, context);
+			Session().GetObjectAsync(request, GetObjectAsyncDone, context);
 
 			return true;
 		}
 
+	Result
+		Endpoint::CreateMultipartUpload(const Aws::String& bn, Request* req)
+		{
+			Aws::S3::Model::CreateMultipartUploadRequest ep_req;
+			ep_req.WithBucket(bn).WithKey(Aws::String(req->key.c_str()));
+
+			Aws::S3::Model::CreateMultipartUploadOutcome out = Session().CreateMultipartUpload(ep_req);
+			if (!out.IsSuccess())
+				return Result(false, out.GetError());
+
+			req->upload_id = out.GetResult().GetUploadId();
+			return Result(true);
+		}
+
+	Result
+		Endpoint::UploadPart(const Aws::String& bn, Request* req, int part_no,
+				unsigned char* buf, long long len)
+		{
+			Aws::S3::Model::UploadPartRequest ep_req;
+			ep_req.WithBucket(bn).WithKey(Aws::String(req->key.c_str()))
+				.WithUploadId(req->upload_id).WithPartNumber(part_no).WithContentLength(len);
+			Aws::Utils::Stream::PreallocatedStreamBuf streambuf(buf, len);
+			ep_req.SetBody(Aws::MakeShared<Aws::IOStream>(DSS_ALLOC_TAG, &streambuf));
+
+			Aws::S3::Model::UploadPartOutcome out = Session().UploadPart(ep_req);
+			if (out.IsSuccess())
+				return Result(true, len, out.GetResult().GetETag());
+			else
+				return Result(false, out.GetError());
+		}
+
+	Result
+		Endpoint::CompleteMultipartUpload(const Aws::String& bn, Request* req,
+				const std::vector<Aws::String>& etags)
+		{
+			Aws::S3::Model::CompleteMultipartUploadRequest ep_req;
+			Aws::S3::Model::CompletedMultipartUpload done;
+
+			for (size_t i = 0; i < etags.size(); i++)
+				done.AddParts(Aws::S3::Model::CompletedPart().WithETag(etags[i]).WithPartNumber(i + 1));
+			ep_req.WithBucket(bn).WithKey(Aws::String(req->key.c_str()))
+				.WithUploadId(req->upload_id).WithMultipartUpload(done);
+
+			Aws::S3::Model::CompleteMultipartUploadOutcome out = Session().CompleteMultipartUpload(ep_req);
+			if (out.IsSuccess())
+				return Result(true);
+			else
+				return Result(false, out.GetError());
+		}
+
+	Result
+		Endpoint::AbortMultipartUpload(const Aws::String& bn, Request* req)
+		{
+			Aws::S3::Model::AbortMultipartUploadRequest ep_req;
+			ep_req.WithBucket(bn).WithKey(Aws::String(req->key.c_str())).WithUploadId(req->upload_id);
+
+			Aws::S3::Model::AbortMultipartUploadOutcome out = Session().AbortMultipartUpload(ep_req);
+			if (out.IsSuccess())
+				return Result(true);
+			else
+				return Result(false, out.GetError());
+		}
+
 	void PutObjectAsyncDone(const Aws::S3::S3Client* s3Client, 
 			const Aws::S3::Model::PutObjectRequest& request, 
 			const Aws::S3::Model::PutObjectOutcome& outcome,
@@ -232,6 +594,10 @@ namespace dss {
 			Callback cb = ctx->getCbFunc();
 			Request* req = (Request*)ctx->getCbArgs();
 
+			// A listing that started after submit may have cached the
+			// key's old state
+			if (req->list_cache)
+				req->list_cache->Invalidate(req->key);
 			cb(req->done_arg, req->key,
 					outcome.GetError().GetMessage().c_str(), 0);
 		} else {
@@ -258,7 +624,7 @@ namespace dss {
 			// Make the asynchronous put object call. Queue the request into a 
 			// thread executor and call the PutObjectAsyncDone function when the 
 			// operation has finished. 
-			m_ses.PutObjectAsync(request, PutObjectAsyncDone, context);
+			Session().PutObjectAsync(request, PutObjectAsyncDone, context);
 
 			return true;
 		}
@@ -271,7 +637,7 @@ namespace dss {
 			request.WithBucket(bn).SetKey(objectName);
 			request.SetBody(input_stream);
 
-			S3::Model::PutObjectOutcome out = m_ses.PutObject(request);
+			S3::Model::PutObjectOutcome out = Session().PutObject(request);
 
 			if (out.IsSuccess()) {
 				return Result(true);
@@ -287,7 +653,7 @@ namespace dss {
 			ep_req.WithBucket(bn).SetKey(Aws::String(req->key.c_str()));
 			ep_req.SetBody(req->io_stream);
 
-			S3::Model::PutObjectOutcome out = m_ses.PutObject(ep_req);
+			S3::Model::PutObjectOutcome out = Session().PutObject(ep_req);
 
 			if (out.IsSuccess()) {
 				return Result(true);
@@ -305,7 +671,7 @@ namespace dss {
 			auto preallocated_stream = Aws::MakeShared<Aws::IOStream>("", &streambuf);
 			ep_req.SetBody(preallocated_stream);
 
-			S3::Model::PutObjectOutcome out = m_ses.PutObject(ep_req);
+			S3::Model::PutObjectOutcome out = Session().PutObject(ep_req);
 
 			if (out.IsSuccess()) {
 				return Result(true);
@@ -322,7 +688,7 @@ namespace dss {
 
 			request.WithBucket(bn).SetKey(objectName);
 
-			auto out = m_ses.DeleteObject(request);
+			auto out = Session().DeleteObject(request);
 
 			if (out.IsSuccess()) {
 				return Result(true);
@@ -338,7 +704,7 @@ namespace dss {
 
 			ep_req.WithBucket(bn).SetKey(Aws::String(req->key.c_str()));
 
-			auto out = m_ses.DeleteObject(ep_req);
+			auto out = Session().DeleteObject(ep_req);
 
 			if (out.IsSuccess()) {
 				return Result(true);
@@ -351,37 +717,77 @@ namespace dss {
 		Endpoint::ListObjects(const Aws::String& bn, Objects *os)
 		{
 			bool cont = false;
+			bool past = false;
 			std::string token;
+			const std::string& last = os->GetLast();
 			S3::Model::ListObjectsV2Outcome out;
 			S3::Model::ListObjectsV2Request req;
 
 			req.WithBucket(bn).WithPrefix(os->GetPrefix()).WithDelimiter(os->GetDelim().c_str());
+			ObjectInfos* infos = os->GetInfos();
+			const ObjectVisitor& visit = os->GetVisitor();
+			const ListFilter& filter = os->GetFilter();
+			const bool filtered = !filter.Empty();
+
+			os->GetPage().BeginRun();
+			if (infos)
+				infos->BeginRun();
 			if (os->PageSizeSet())
 				req.SetMaxKeys(os->GetPageSize());
 			if (os->TokenSet())
 				req.SetContinuationToken(os->GetToken().c_str());
+			else if (!os->GetStartAfter().empty())
+				req.SetStartAfter(os->GetStartAfter().c_str());
+
+			auto beyond = [&last](const Aws::String& k) {
+				return !last.empty() &&
+					KeyList::Compare(k.c_str(), k.size(), last.data(), last.size()) > 0;
+			};
 
 			do {
-				out = m_ses.ListObjectsV2(req);
+				out = Session().ListObjectsV2(req);
 				if (out.IsSuccess()) {
-					//TODO: std::move()
-					Aws::Vector<Aws::S3::Model::Object> objects =
-						std::move(out.GetResult().GetContents());
-					for (auto o : objects)
-						os->GetPage().insert(o.GetKey().c_str());
-
-					if (os->NeedCommPrefix()) {
-						Aws::Vector<Aws::S3::Model::CommonPrefix> cps =
-							std::move(out.GetResult().GetCommonPrefixes());
-
-						for (auto cp : cps) {
-							if ((os->GetCPre().find(cp.GetPrefix().c_str())) == os->GetCPre().end()){
-								os->GetPage().insert(cp.GetPrefix().c_str());
-								os->GetCPre().insert(cp.GetPrefix().c_str());
-							}
-							else
+					const Aws::Vector<Aws::S3::Model::Object>& objects =
+						out.GetResult().GetContents();
+					const Aws::Vector<Aws::S3::Model::CommonPrefix>& cps =
+						out.GetResult().GetCommonPrefixes();
+					size_t i = 0, j = 0;
+
+					if (!os->NeedCommPrefix())
+						j = cps.size();
+
+					// Both lists come sorted, interleave them into one run
+					while (i < objects.size() || j < cps.size()) {
+						if (j == cps.size() || (i < objects.size() &&
+									objects[i].GetKey() < cps[j].GetPrefix())) {
+							const Aws::S3::Model::Object& o = objects[i++];
+							const Aws::String& k = o.GetKey();
+							if ((past = beyond(k)))
+								break;
+							if (filtered && !filter.Match(k.c_str(), k.size(), o.GetSize()))
 								continue;
-						}            	
+							if (visit) {
+								visit(k.c_str(), k.size(), o.GetSize());
+							} else if (infos) {
+								infos->Append(std::string(k.c_str(), k.size()), o.GetSize(),
+										Unquote(o.GetETag()), o.GetLastModified().Millis());
+							} else {
+								os->GetPage().Append(k.c_str(), k.size());
+							}
+							continue;
+						}
+
+						const Aws::String& cp = cps[j++].GetPrefix();
+						if ((past = beyond(cp)))
+							break;
+						if (os->GetCPre().insert(cp.c_str()).second)
+							os->GetPage().Append(cp.c_str(), cp.size());
+					}
+
+					// Rest of the listing belongs to the next range
+					if (past) {
+						os->SetToken("");
+						break;
 					}
 				} 
 				else {
@@ -405,25 +811,15 @@ namespace dss {
 			return Result(true);
 		}
 
-	Result
-		ClusterMap::TryLockClusters() {
-			return m_client->TryLockClusters();
-		}
-
-	Result
-		ClusterMap::UnlockClusters() {
-			return m_client->UnlockClusters();
-		}
-
 	int
-		ClusterMap::AcquireClusterConf(const std::string& uuid, const unsigned int endpoint_per_cluster)
+		ClusterMap::AcquireClusterConf(Client* client, const std::string& uuid, const unsigned int endpoint_per_cluster)
 		{
 			//TODO: redo this function
 			Result r;
 			std::fstream file;
 
 			if (!GetClusterConfFromLocal()) {
-				r = m_client->GetClusterConfig();
+				r = client->GetClusterConfig();
 				if (!r.IsSuccess()) {
 					auto err = r.GetErrorType();
 					if (err == Aws::S3::S3Errors::NETWORK_CONNECTION)
@@ -458,32 +854,43 @@ namespace dss {
 					m_wait_time = conf.at("init_time").get<unsigned>();
 				} catch (std::exception&) {}
 
+				const SesOptions& opts = client->GetOptions();
+
 				for (auto &c : conf["clusters"]) {
-					std::vector<std::string> hash_vals = {};
-					std::map<std::string, int> hash_val_map;
-					std::string val;
+					struct Candidate {
+						unsigned distance;
+						unsigned weight;
+						unsigned idx;
+					};
+					std::vector<Candidate> cands;
 					unsigned i = 0;
-					unsigned ep_count = 0;
 
 					Cluster* cluster = InsertCluster(c["id"], uuid);
 					pr_debug("Adding cluster %u\n", (uint32_t)c["id"]);
 					for (auto &ep : c["endpoints"]){
 						pr_debug("Cluster ID: %u Endpoint %s:%u\n",
-								(uint32_t)c["id"], std::string(ep["ipv4"]), (uint32_t)ep["port"]);
-						val = GetCLWeight(uuid, std::string(ep["ipv4"]));
-						hash_vals.push_back(val);
-						push_heap(hash_vals.begin(), hash_vals.end());
-						hash_val_map[val] = ep_count;
-						ep_count++;
+								(uint32_t)c["id"], std::string(ep["ipv4"]).c_str(), (uint32_t)ep["port"]);
+						cands.push_back(Candidate{GetLocalityDistance(opts, ep),
+								GetCLWeight(uuid, std::string(ep["ipv4"])), i++});
 					}
-					for (i = 0; i < endpoint_per_cluster && i < ep_count; i++){
-						val = hash_vals.front();
-						auto ep = c["endpoints"].at(hash_val_map[val]);
-						pr_debug("Inserting endpoint Cluster ID: %u EP %s:%u\n",
-								(uint32_t)c["id"], std::string(ep["ipv4"]), (uint32_t)ep["port"]);
-						cluster->InsertEndpoint(m_client, ep["ipv4"], ep["port"]);
-						pop_heap(hash_vals.begin(), hash_vals.end());
-						hash_vals.pop_back();
+
+					// Nearest endpoints first, the uuid hash spreads clients
+					// deterministically among endpoints of the same distance
+					std::sort(cands.begin(), cands.end(),
+							[](const Candidate& a, const Candidate& b) {
+							if (a.distance != b.distance)
+								return a.distance < b.distance;
+							if (a.weight != b.weight)
+								return a.weight > b.weight;
+							return a.idx < b.idx;
+							});
+
+					for (i = 0; i < endpoint_per_cluster && i < cands.size(); i++){
+						auto ep = c["endpoints"].at(cands[i].idx);
+						pr_debug("Inserting endpoint Cluster ID: %u EP %s:%u distance %u\n",
+								(uint32_t)c["id"], std::string(ep["ipv4"]).c_str(),
+								(uint32_t)ep["port"], cands[i].distance);
+						cluster->InsertEndpoint(client, ep["ipv4"], ep["port"]);
 					}
 
 				}
@@ -494,6 +901,30 @@ namespace dss {
 			return 0;
 		}
 
+	/* Network distance between this client and an endpoint entry of
+	 * conf.json, based on the optional "rack", "subnet" and "zone" labels.
+	 * Unlabeled endpoints, or a client without locality, are all equally far */
+	unsigned
+		ClusterMap::GetLocalityDistance(const SesOptions& opts, const nlohmann::json& ep)
+		{
+			const std::pair<const std::string*, const char*> levels[] = {
+				{&opts.rack, "rack"},
+				{&opts.subnet, "subnet"},
+				{&opts.zone, "zone"},
+			};
+			unsigned d = 0;
+
+			for (auto& l : levels) {
+				auto it = ep.find(l.second);
+				if (!l.first->empty() && it != ep.end() &&
+						it->is_string() && it->get<std::string>() == *l.first)
+					return d;
+				d++;
+			}
+
+			return d;
+		}
+
 	ClusterMap::Status
 		ClusterMap::DetectClusterBuckets(bool force)
 		{
@@ -599,7 +1030,8 @@ namespace dss {
 	int
 		Cluster::InsertEndpoint(Client* c, const std::string& ip, uint32_t port)
 		{
-			Endpoint* ep = new Endpoint(c->GetCredential(), ip + ":" + std::to_string(port), c->GetConfig()); 
+			Endpoint* ep = new Endpoint(c->GetCredential(), ip + ":" + std::to_string(port), c->GetConfig(),
+					c->GetOptions().localInterfaces);
 			m_endpoints.push_back(ep);
 
 			pr_debug("Insert endpoint %s\n", (ip + ":" + std::to_string(port)).c_str());
@@ -643,6 +1075,144 @@ namespace dss {
 			return GetEndpoint(r)->GetObject(m_bucket, r, resp_buff, buffer_size);
 		}
 
+	Result
+		Cluster::HeadObject(Request* r)
+		{
+			return GetEndpoint(r)->HeadObject(m_bucket, r);
+		}
+
+	Result
+		Cluster::GetObjectFirstPart(Request* r, unsigned char* buf, long long len)
+		{
+			return GetEndpoint(r)->GetObjectFirstPart(m_bucket, r, buf, len);
+		}
+
+	Result
+		Cluster::GetObjectSegments(Request* r, SegmentStreamBuf* sb)
+		{
+			return GetEndpoint(r)->GetObjectSegments(m_bucket, r, sb);
+		}
+
+	Result
+		Cluster::GetObjectSized(Request* r, PoolSink* sink)
+		{
+			return GetEndpoint(r)->GetObjectSized(m_bucket, r, sink);
+		}
+
+	/* Bytes [from, size) of the object into the same offsets of buf. Part
+	 * i goes to endpoint key_hash + i, a few workers per endpoint (up to
+	 * DSS_PART_WORKERS in all) take parts in order until all are in or
+	 * one fails */
+	Result
+		Cluster::GetObjectRanges(Request* r, unsigned char* buf, long long from,
+				long long size, long long part, const Aws::String& etag)
+		{
+			size_t parts = (size - from + part - 1) / part;
+			unsigned workers = std::min<size_t>(parts, PartWorkers());
+			std::vector<std::future<Result>> futs;
+			std::atomic<size_t> next(0);
+			std::atomic<bool> failed(false);
+			Result res(true, size);
+
+			for (unsigned w = 0; w < workers; w++) {
+				futs.push_back(std::async(std::launch::async,
+							[this, r, buf, from, size, part, parts, &etag, &next, &failed]() -> Result {
+							size_t i;
+							while (!failed && (i = next++) < parts) {
+								long long off = from + i * part;
+								long long len = std::min(part, size - off);
+								Endpoint* ep = m_endpoints[(r->key_hash + i) % m_endpoints.size()];
+								Result pr = ep->GetObjectRange(m_bucket, r, buf + off, off, len, etag);
+
+								if (pr.IsSuccess() && pr.GetContentLengthValue() != len)
+									pr = Result(false, Aws::S3::S3Errors::UNKNOWN,
+											Aws::String(("Short range read of " + r->key).c_str()));
+								if (!pr.IsSuccess()) {
+									failed = true;
+									return pr;
+								}
+							}
+							return Result(true, size);
+							}));
+			}
+
+			for (auto& f : futs) {
+				Result fr = f.get();
+				if (!fr.IsSuccess() && res.IsSuccess())
+					res = std::move(fr);
+			}
+
+			return res;
+		}
+
+	/* The upload is created and completed through the key's endpoint.
+	 * Parts spread like GetObjectRanges(), a failed part is retried on
+	 * the next endpoints before the whole upload is aborted, so the key
+	 * never shows a partial object */
+	Result
+		Cluster::PutObjectParts(Request* r, long long size, long long part,
+				unsigned retries, const PartReader& read)
+		{
+			Endpoint* ep = GetEndpoint(r);
+			std::atomic<size_t> next(0);
+			std::atomic<bool> failed(false);
+			std::vector<std::future<Result>> futs;
+
+			part = std::max(part, DSS_MULTIPART_MIN_PART);
+			if ((size + part - 1) / part > DSS_MULTIPART_MAX_PARTS)
+				part = (size + DSS_MULTIPART_MAX_PARTS - 1) / DSS_MULTIPART_MAX_PARTS;
+			size_t parts = std::max<long long>(1, (size + part - 1) / part);
+			unsigned workers = std::min<size_t>(parts, PartWorkers());
+			std::vector<Aws::String> etags(parts);
+
+			Result res = ep->CreateMultipartUpload(m_bucket, r);
+			if (!res.IsSuccess())
+				return res;
+
+			for (unsigned w = 0; w < workers; w++) {
+				futs.push_back(std::async(std::launch::async,
+							[this, r, size, part, parts, retries, &read, &etags, &next, &failed]() -> Result {
+							std::vector<unsigned char> scratch;
+							size_t i;
+							while (!failed && (i = next++) < parts) {
+								long long off = i * part;
+								long long len = std::min(part, size - off);
+								unsigned char* p = read(off, len, scratch);
+
+								if (!p) {
+									failed = true;
+									return Result(false, Aws::S3::S3Errors::UNKNOWN,
+											Aws::String(("Reading " + r->key + ": " + strerror(errno)).c_str()));
+								}
+
+								Result pr = m_endpoints[(r->key_hash + i) % m_endpoints.size()]->
+									UploadPart(m_bucket, r, i + 1, p, len);
+								for (unsigned a = 1; !pr.IsSuccess() && a <= retries; a++)
+									pr = m_endpoints[(r->key_hash + i + a) % m_endpoints.size()]->
+										UploadPart(m_bucket, r, i + 1, p, len);
+								if (!pr.IsSuccess()) {
+									failed = true;
+									return pr;
+								}
+								etags[i] = pr.GetETag();
+							}
+							return Result(true);
+							}));
+			}
+
+			for (auto& f : futs) {
+				Result fr = f.get();
+				if (!fr.IsSuccess() && res.IsSuccess())
+					res = std::move(fr);
+			}
+
+			if (res.IsSuccess())
+				res = ep->CompleteMultipartUpload(m_bucket, r, etags);
+			if (!res.IsSuccess())
+				ep->AbortMultipartUpload(m_bucket, r);
+
+			return res;
+		}
 
 	Result
 		Cluster::PutObject(const Aws::String& objectName, std::shared_ptr<Aws::IOStream>& input_stream)
@@ -728,16 +1298,86 @@ namespace dss {
 	int
 		Client::InitClusterMap(const std::string& uuid, const unsigned int endpoints_per_cluster)
 		{
-			ClusterMap* map = new ClusterMap(this, dss_init);
-			if (map->AcquireClusterConf(uuid, endpoints_per_cluster) < 0)
+			SessionRegistry::Entry e;
+			std::shared_ptr<SessionRegistry::Slot> slot;
+			std::unique_lock<std::mutex> lock;
+
+			if (m_opts.shareEndpoints) {
+				slot = session_registry.GetSlot(
+						SessionRegistry::MakeKey(m_url, m_cred, m_opts, uuid, endpoints_per_cluster));
+				lock = std::unique_lock<std::mutex>(slot->mutex());
+				if (slot->Find(e)) {
+					pr_debug("Reusing cluster map for %s\n", m_url.c_str());
+					m_discover_ep = e.discover_ep;
+					m_cluster_map = e.cluster_map;
+					return 0;
+				}
+			}
+
+			m_discover_ep = std::make_shared<Endpoint>(m_cred, m_url, m_cfg, m_opts.localInterfaces);
+
+			std::shared_ptr<ClusterMap> map(new ClusterMap(dss_init));
+			if (map->AcquireClusterConf(this, uuid, endpoints_per_cluster) < 0)
 				return -1;
 			if (map->VerifyClusterConf() < 0)
 				return -1;
 
 			m_cluster_map = map;
+			if (slot)
+				slot->Insert(SessionRegistry::Entry{m_discover_ep, m_cluster_map});
+
 			return 0;
 		}
 
+	/* Concurrent HeadBucket requests make each endpoint's connection pool
+	 * open (and keep alive) count connections. A few workers go through
+	 * the endpoints in turn, all requests to one endpoint in flight
+	 * together, rather than a thread per connection */
+	long
+		Client::WarmupConnections(unsigned int count)
+		{
+			struct Target {
+				Endpoint* ep;
+				const Aws::String* bucket;
+			};
+			std::vector<Target> reqs;
+			std::vector<std::future<void>> futs;
+			std::atomic<size_t> next(0);
+			std::atomic<unsigned> ok(0);
+			auto start = std::chrono::steady_clock::now();
+
+			if (!m_cluster_map)
+				return -1;
+
+			// Connections beyond the pool size would just be torn down again
+			count = std::min<unsigned>(count, m_cfg.maxConnections);
+			count = std::min<unsigned>(count, DSS_WARMUP_WORKERS);
+
+			for (auto c : m_cluster_map->GetClusters())
+				for (auto ep : c->GetEndpoints())
+					for (unsigned i = 0; i < count; i++)
+						reqs.push_back(Target{ep, &c->GetBucket()});
+
+			unsigned workers = std::min<size_t>(reqs.size(), DSS_WARMUP_WORKERS);
+			for (unsigned w = 0; w < workers; w++) {
+				futs.push_back(std::async(std::launch::async, [&reqs, &next, &ok]() {
+							size_t i;
+							while ((i = next++) < reqs.size())
+								if (reqs[i].ep->HeadBucket(*reqs[i].bucket).IsSuccess())
+									ok++;
+							}));
+			}
+
+			for (auto& f : futs)
+				f.get();
+
+			m_warmup_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+					std::chrono::steady_clock::now() - start).count();
+			pr_debug("Warmed up %u connections in %ld ms\n", ok.load(), m_warmup_ms);
+
+			return m_warmup_ms;
+		}
+
 	Result
 		Request::Submit(Handler handler)
 		{
@@ -751,29 +1391,61 @@ namespace dss {
 		}
 
 
+	static void
+		CheckResult(Result& r)
+		{
+			if (!r.IsSuccess()) {
+				auto err = r.GetErrorType();
+				if (err == Aws::S3::S3Errors::RESOURCE_NOT_FOUND)
+					throw NoSuchResourceError();
+				else
+					throw GenericError(r.GetErrorMsg().c_str());
+			}
+		}
+
+	static void
+		CheckResult(Result&& r)
+		{
+			CheckResult(r);
+		}
+
 	int Client::GetObject(const Aws::String& objectName, const Aws::String& dest_filename)
 	{
 		std::unique_ptr<Request> req_guard(new Request(objectName.c_str(), dest_filename.c_str()));
 
 		m_cluster_map->GetCluster(req_guard.get());
+		if (m_opts.rangedGetThreshold && m_opts.rangedGetPartSize > 0) {
+			// The first part stands in for a HEAD, and holds all of a
+			// small object
+			long long part = m_opts.rangedGetPartSize;
+			std::unique_ptr<unsigned char[]> first(new unsigned char[part]);
+			Result r = req_guard->Submit_with_buffer(&Cluster::GetObjectFirstPart, first.get(), part);
+			CheckResult(r);
+
+			long long size = r.GetContentLengthValue();
+			if (size > part)
+				return GetObjectToMap(req_guard.get(), r, first.get(), part);
+
+			req_guard->sink = OpenFileSink(req_guard->file);
+			req_guard->sink->Preallocate(size);
+			req_guard->sink->sputn((const char*)first.get(), size);
+			if (req_guard->sink->Commit() < 0) {
+				auto e = std::system_error(errno, std::system_category(),
+						"Path " + req_guard->file);
+				throw FileIOError(e.what());
+			}
+
+			return 0;
+		}
+
+		req_guard->sink = OpenFileSink(req_guard->file);
 		Result r = req_guard->Submit(&Cluster::GetObject);
 
 		if (r.IsSuccess()) {
-			std::fstream fs;
-			fs.exceptions(std::fstream::failbit | std::fstream::badbit);
-
-			try {
-				fs.open(dest_filename.c_str(), std::ios::out | std::ios::binary);
-				//TODO: revist performance
-				fs << r.GetIOStream().rdbuf();
-				fs.flush();
-				fs.close();
-			} catch (std::exception&) {
-				std::string fname(dest_filename.c_str());
+			if (req_guard->sink->Commit() < 0) {
 				auto e = std::system_error(errno, std::system_category(),
-						"Path " + fname);
+						"Path " + req_guard->file);
 				throw FileIOError(e.what());
-				return -1;
 			}
 
 			return 0;
@@ -788,16 +1460,127 @@ namespace dss {
 		}
 	}
 
-	int Client::GetObjectNumpyBuffer(const Aws::String& objectName, py::array_t<uint8_t> numpy_buffer)
-	{
-		std::unique_ptr<Request> req_guard(new Request(objectName.c_str()));
-		py::buffer_info info = numpy_buffer.request();
-		long int buffer_size = numpy_buffer.size();
-		auto ptr = static_cast<unsigned char*> (info.ptr);
-
-		m_cluster_map->GetCluster(req_guard.get());
+	std::shared_ptr<FileSink>
+		Client::OpenFileSink(const std::string& path)
+		{
+			std::shared_ptr<FileSink> sink = std::make_shared<FileSink>(
+					m_opts.fileBlockSize ? m_opts.fileBlockSize : DSS_FILESINK_BLOCK,
+					m_opts.directIO, m_opts.atomicDownload);
 
-		Result r = req_guard->Submit_with_buffer(&Cluster::GetObject, ptr, buffer_size);
+			if (sink->Open(path) < 0) {
+				auto e = std::system_error(errno, std::system_category(), "Path " + path);
+				throw FileIOError(e.what());
+			}
+
+			return sink;
+		}
+
+	/* The destination is created at the object's size and mapped, the
+	 * body is received straight into the mapping. The size comes from a
+	 * HEAD, or from the first part when ranged GETs are on */
+	int Client::GetObjectMapped(const Aws::String& objectName, const Aws::String& dest_fn)
+	{
+		std::unique_ptr<Request> req_guard(new Request(objectName.c_str(), dest_fn.c_str()));
+
+		m_cluster_map->GetCluster(req_guard.get());
+		if (m_opts.rangedGetThreshold && m_opts.rangedGetPartSize > 0) {
+			long long part = m_opts.rangedGetPartSize;
+			std::unique_ptr<unsigned char[]> first(new unsigned char[part]);
+			Result r = req_guard->Submit_with_buffer(&Cluster::GetObjectFirstPart, first.get(), part);
+			CheckResult(r);
+
+			return GetObjectToMap(req_guard.get(), r, first.get(), part);
+		}
+
+		Result head = req_guard->Submit(&Cluster::HeadObject);
+		CheckResult(head);
+
+		return GetObjectToMap(req_guard.get(), head, nullptr, 0);
+	}
+
+	/* The first got bytes already fetched are copied in, the rest goes
+	 * straight into the mapping */
+	int Client::GetObjectToMap(Request* req, Result& head, const unsigned char* first, long long got)
+	{
+		FileMap map(m_opts.atomicDownload);
+		Result r;
+
+		if (map.Open(req->file, head.GetContentLengthValue()) < 0) {
+			auto e = std::system_error(errno, std::system_category(), "Path " + req->file);
+			throw FileIOError(e.what());
+		}
+
+		got = std::min<long long>(got, map.Size());
+		if (got)
+			memcpy(map.Data(), first, got);
+		r = GetObjectRest(req, map.Data(), got, head);
+		CheckResult(r);
+
+		if (map.Commit(r.GetContentLengthValue()) < 0) {
+			auto e = std::system_error(errno, std::system_category(), "Path " + req->file);
+			throw FileIOError(e.what());
+		}
+
+		return 0;
+	}
+
+	bool
+		Client::UseMultipart(long long size)
+		{
+			return m_opts.multipartThreshold && size >= m_opts.multipartThreshold;
+		}
+
+	bool
+		Client::UseRanges(long long size)
+		{
+			return m_opts.rangedGetThreshold && m_opts.rangedGetPartSize > 0 &&
+				size >= m_opts.rangedGetThreshold;
+		}
+
+	/* The object past its first from bytes into buf, once a HEAD or the
+	 * first part told its size and ETag: as parallel parts past the
+	 * threshold, else as one range. If-Match keeps them on that version */
+	Result
+		Client::GetObjectRest(Request* req, unsigned char* buf, long long from, Result& first)
+		{
+			long long size = first.GetContentLengthValue();
+
+			if (from >= size)
+				return Result(true, size);
+
+			return req->cluster->GetObjectRanges(req, buf, from, size,
+					UseRanges(size) ? m_opts.rangedGetPartSize : size - from, first.GetETag());
+		}
+
+	/* A buffer below the threshold can't take a ranged object. Otherwise
+	 * the first part goes straight into the buffer and tells the object's
+	 * size, the rest is only requested for a larger object */
+	Result
+		Client::GetObjectInto(Request* req, unsigned char* buf, long long size)
+		{
+			if (UseRanges(size)) {
+				long long part = std::min(m_opts.rangedGetPartSize, size);
+				Result first = req->Submit_with_buffer(&Cluster::GetObjectFirstPart, buf, part);
+
+				if (!first.IsSuccess())
+					return first;
+				if (first.GetContentLengthValue() <= size)
+					return GetObjectRest(req, buf, part, first);
+			}
+
+			return req->Submit_with_buffer(&Cluster::GetObject, buf, size);
+		}
+
+	long long Client::GetObjectNumpyBuffer(const Aws::String& objectName, py::array_t<uint8_t> numpy_buffer)
+	{
+		std::unique_ptr<Request> req_guard(new Request(objectName.c_str()));
+		py::buffer_info info = numpy_buffer.request();
+		long int buffer_size = numpy_buffer.size();
+		auto ptr = static_cast<unsigned char*> (info.ptr);
+
+		m_cluster_map->GetCluster(req_guard.get());
+
+		Result r = GetObjectInto(req_guard.get(), ptr, buffer_size);
 
 		if (r.IsSuccess()) {
 			return r.GetContentLengthValue();
@@ -812,7 +1595,7 @@ namespace dss {
 		}
 	}
 
-	int Client::GetObjectBuffer(const Aws::String& objectName, py::buffer buffer)
+	long long Client::GetObjectBuffer(const Aws::String& objectName, py::buffer buffer)
 	{
 		std::unique_ptr<Request> req_guard(new Request(objectName.c_str()));
 		py::buffer_info info = buffer.request();
@@ -821,7 +1604,7 @@ namespace dss {
 
 		m_cluster_map->GetCluster(req_guard.get());
 
-		Result r = req_guard->Submit_with_buffer(&Cluster::GetObject, ptr, buffer_size);
+		Result r = GetObjectInto(req_guard.get(), ptr, buffer_size);
 
 		if (r.IsSuccess()) {
 			return r.GetContentLengthValue();
@@ -837,6 +1620,113 @@ namespace dss {
 	}
 
 
+	/* Upload body read straight from a read-only mapping of the file. The
+	 * stream owns the mapping, which lives as long as the SDK holds on to
+	 * the body, also for async requests */
+	static std::shared_ptr<Aws::IOStream>
+		MappedBody(std::shared_ptr<FileSource> src)
+		{
+			static unsigned char empty;
+			auto buf = std::make_shared<Aws::Utils::Stream::PreallocatedStreamBuf>(
+					src->Size() ? src->Data() : &empty, src->Size());
+
+			return std::shared_ptr<Aws::IOStream>(Aws::New<Aws::IOStream>(DSS_ALLOC_TAG, buf.get()),
+					[src, buf](Aws::IOStream* s) { Aws::Delete(s); });
+		}
+
+	static std::shared_ptr<Aws::IOStream>
+		OpenBody(const std::string& path)
+		{
+			std::shared_ptr<FileSource> src = std::make_shared<FileSource>();
+
+			if (src->Open(path) == 0)
+				return MappedBody(src);
+
+			// Not mappable (a pipe, a special file), read it through a stream
+			return Aws::MakeShared<Aws::FStream>(DSS_ALLOC_TAG, path.c_str(),
+					std::ios_base::in | std::ios_base::binary);
+		}
+
+	/* Buffers are filled in order, an object larger than all of them
+	 * fails. The GIL is dropped while the views are held */
+	long long Client::GetObjectBuffers(const Aws::String& objectName, std::vector<py::buffer> buffers)
+	{
+		std::vector<py::buffer_info> infos;
+		std::vector<struct iovec> segs;
+		Result r;
+
+		for (auto& b : buffers) {
+			infos.push_back(b.request(true));
+			segs.push_back(iovec{infos.back().ptr, (size_t)(infos.back().size * infos.back().itemsize)});
+		}
+
+		SegmentStreamBuf body(segs, std::ios_base::out);
+		std::unique_ptr<Request> req_guard(new Request(objectName.c_str()));
+		m_cluster_map->GetCluster(req_guard.get());
+		{
+			py::gil_scoped_release nogil;
+			r = req_guard->cluster->GetObjectSegments(req_guard.get(), &body);
+		}
+		CheckResult(r);
+
+		return r.GetContentLengthValue();
+	}
+
+	/* The buffer returns to the pool when the caller drops it */
+	std::shared_ptr<PoolBuffer>
+		Client::GetObjectPooled(const Aws::String& objectName, long long size)
+		{
+			std::unique_ptr<Request> req_guard(new Request(objectName.c_str()));
+			std::shared_ptr<PoolBuffer> buf;
+			Result r;
+
+			if (size < 0)
+				throw GenericError("Negative size " + std::to_string(size));
+
+			buf = m_pool->Get(size);
+			if (!buf) {
+				auto e = std::system_error(errno, std::system_category(), "Buffer pool");
+				throw GenericError(e.what());
+			}
+
+			m_cluster_map->GetCluster(req_guard.get());
+			{
+				py::gil_scoped_release nogil;
+				r = GetObjectInto(req_guard.get(), buf->Data(), size);
+			}
+			CheckResult(r);
+			buf->SetSize(r.GetContentLengthValue());
+
+			return buf;
+		}
+
+	/* Allocated once at the object's size, from the pool's class for it
+	 * (or on its own past bufferPoolMaxSize) */
+	std::shared_ptr<PoolBuffer>
+		Client::GetObjectSized(const Aws::String& objectName)
+		{
+			std::unique_ptr<Request> req_guard(new Request(objectName.c_str()));
+			PoolSink sink(m_pool);
+			std::shared_ptr<PoolBuffer> buf;
+			Result r;
+			int err = 0;
+
+			m_cluster_map->GetCluster(req_guard.get());
+			{
+				py::gil_scoped_release nogil;
+				r = req_guard->cluster->GetObjectSized(req_guard.get(), &sink);
+				if (r.IsSuccess() && !(buf = sink.Take()))
+					err = errno;
+			}
+			CheckResult(r);
+			if (!buf) {
+				auto e = std::system_error(err, std::system_category(), "Buffer pool");
+				throw GenericError(e.what());
+			}
+
+			return buf;
+		}
+
 	int Client::PutObjectAsync(const std::string& objectName, const std::string& src_fn,
 			Callback cb, void* cb_arg)
 	{
@@ -850,12 +1740,12 @@ namespace dss {
 			return -1;
 		}
 
-		req->io_stream = Aws::MakeShared<Aws::FStream>(DSS_ALLOC_TAG,
-				src_fn.c_str(),
-				std::ios_base::in | std::ios_base::binary);
+		req->io_stream = OpenBody(src_fn);
+		req->list_cache = &m_cluster_map->GetListCache();
 
 		m_cluster_map->GetCluster(req);
 		r = std::move(req->Submit(&Cluster::PutObjectAsync));
+		m_cluster_map->GetListCache().Invalidate(objectName);
 
 		if (r.IsSuccess()) {
 			return 0;
@@ -875,7 +1765,10 @@ namespace dss {
 	{
 		Result r;
 
-		Request* req = new Request(objectName.c_str(), dst_fn.c_str(), cb, cb_arg);
+		std::unique_ptr<Request> req_guard(new Request(objectName.c_str(), dst_fn.c_str(), cb, cb_arg));
+
+		req_guard->sink = OpenFileSink(req_guard->file);
+		Request* req = req_guard.release();
 
 		m_cluster_map->GetCluster(req);
 		r = std::move(req->Submit(&Cluster::GetObjectAsync));
@@ -906,15 +1799,33 @@ namespace dss {
 			return false;
 		}
 
-		req_guard->io_stream = Aws::MakeShared<Aws::FStream>(DSS_ALLOC_TAG,
-				src_fn.c_str(),
-				std::ios_base::in | std::ios_base::binary);
-
 		m_cluster_map->GetCluster(req_guard.get());
+		if (!async && UseMultipart(buffer.st_size)) {
+			FileSource src;
+
+			if (src.Open(src_fn) < 0) {
+				auto e = std::system_error(errno, std::system_category(), "Path " + src_fn);
+				throw FileIOError(e.what());
+			}
+
+			r = req_guard->cluster->PutObjectParts(req_guard.get(), src.Size(),
+					m_opts.multipartPartSize, m_opts.multipartRetries,
+					[&src](long long off, long long len, std::vector<unsigned char>&) {
+					return src.Data() + off;
+					});
+			m_cluster_map->GetListCache().Invalidate(objectName.c_str());
+			CheckResult(r);
+
+			return 0;
+		}
+
+		req_guard->io_stream = OpenBody(src_fn);
+
 		if (!async)
 			r = std::move(req_guard->Submit(&Cluster::PutObject));
 		else
 			r = std::move(req_guard->Submit(&Cluster::PutObjectAsync));
+		m_cluster_map->GetListCache().Invalidate(objectName.c_str());
 
 		if (r.IsSuccess()) {
 			return 0;
@@ -929,16 +1840,28 @@ namespace dss {
 		}
 	}
 
-	int Client::PutObjectBuffer(const Aws::String& objectName, py::buffer buffer, int content_length)
+	int Client::PutObjectBuffer(const Aws::String& objectName, py::buffer buffer, long long content_length)
 	{
 		py::buffer_info info = buffer.request();
-		//long int buffer_size = info.size;
+		long long buffer_size = info.size * info.itemsize;
 		auto ptr = static_cast<unsigned char*> (info.ptr);
 
+		if (content_length < 0 || content_length > buffer_size)
+			throw GenericError("content_length " + std::to_string(content_length) +
+					" out of buffer size " + std::to_string(buffer_size));
+
 		Result r;
 		std::unique_ptr<Request> req_guard(new Request(objectName.c_str()));
 		m_cluster_map->GetCluster(req_guard.get());
-		r = req_guard->Submit_with_buffer(&Cluster::PutObject, ptr, content_length);
+		if (UseMultipart(content_length))
+			r = req_guard->cluster->PutObjectParts(req_guard.get(), content_length,
+					m_opts.multipartPartSize, m_opts.multipartRetries,
+					[ptr](long long off, long long len, std::vector<unsigned char>&) {
+					return ptr + off;
+					});
+		else
+			r = req_guard->Submit_with_buffer(&Cluster::PutObject, ptr, content_length);
+		m_cluster_map->GetListCache().Invalidate(objectName.c_str());
 
 		if (r.IsSuccess()) {
 			return 0;
@@ -954,11 +1877,48 @@ namespace dss {
 	}
 
 
+	/* The buffers are streamed in order as one body, the GIL is dropped
+	 * while the views are held */
+	int Client::PutObjectBuffers(const Aws::String& objectName, std::vector<py::buffer> buffers)
+	{
+		std::vector<py::buffer_info> infos;
+		std::vector<struct iovec> segs;
+		Result r;
+
+		for (auto& b : buffers) {
+			infos.push_back(b.request());
+			segs.push_back(iovec{infos.back().ptr, (size_t)(infos.back().size * infos.back().itemsize)});
+		}
+
+		SegmentStreamBuf body(segs);
+		std::unique_ptr<Request> req_guard(new Request(objectName.c_str()));
+		m_cluster_map->GetCluster(req_guard.get());
+		{
+			py::gil_scoped_release nogil;
+
+			if (UseMultipart(body.Size())) {
+				r = req_guard->cluster->PutObjectParts(req_guard.get(), body.Size(),
+						m_opts.multipartPartSize, m_opts.multipartRetries,
+						[&body](long long off, long long len, std::vector<unsigned char>& scratch) {
+						return body.Gather(off, len, scratch);
+						});
+			} else {
+				req_guard->io_stream = Aws::MakeShared<Aws::IOStream>(DSS_ALLOC_TAG, &body);
+				r = req_guard->Submit(&Cluster::PutObject);
+			}
+		}
+		m_cluster_map->GetListCache().Invalidate(objectName.c_str());
+		CheckResult(r);
+
+		return 0;
+	}
+
 	int Client::DeleteObject(const Aws::String& objectName)
 	{
 		std::unique_ptr<Request> req_guard(new Request(objectName.c_str()));
 		m_cluster_map->GetCluster(req_guard.get());
 		Result r = req_guard->Submit(&Cluster::DeleteObject);
+		m_cluster_map->GetListCache().Invalidate(objectName.c_str());
 
 		if (r.IsSuccess()) {
 			return 0;
@@ -973,41 +1933,719 @@ namespace dss {
 		}
 	}
 
-	std::set<std::string>&&
-		Client::ListObjects(const std::string& prefix, const std::string& delimit)
+	ListFilter::ListFilter(const std::vector<std::string>& suffixes, const std::string& glob,
+			const std::string& regex, int64_t min_size, int64_t max_size) :
+		m_suffixes(suffixes),
+		m_glob(glob),
+		m_min_size(min_size),
+		m_max_size(max_size)
+	{
+		if (regex.empty())
+			return;
+
+		try {
+			m_regex = std::make_shared<const std::regex>(regex, std::regex::optimize);
+		} catch (const std::regex_error& e) {
+			throw GenericError("Invalid regex '" + regex + "': " + e.what());
+		}
+	}
+
+	bool
+		ListFilter::Match(const char* key, size_t len, int64_t size) const
 		{
-			std::unique_ptr<Objects> objs = GetObjects(prefix, delimit, 0);
-			const std::vector<Cluster*> clusters = m_cluster_map->GetClusters();
+			if (size >= 0 && ((m_min_size >= 0 && size < m_min_size) ||
+						(m_max_size >= 0 && size > m_max_size)))
+				return false;
+
+			if (!m_suffixes.empty()) {
+				bool found = false;
+				for (auto& s : m_suffixes) {
+					if (s.size() <= len && !memcmp(key + len - s.size(), s.data(), s.size())) {
+						found = true;
+						break;
+					}
+				}
+				if (!found)
+					return false;
+			}
+
+			if (!m_glob.empty() && fnmatch(m_glob.c_str(), std::string(key, len).c_str(), 0))
+				return false;
+
+			if (m_regex && !std::regex_search(key, key + len, *m_regex))
+				return false;
+
+			return true;
+		}
+
+	/* Cuts splitting the listing of prefix over clusters into about ways
+	 * ranges (cut k-1, cut k], sampled from a first page of every cluster.
+	 *
+	 * The merged sample is moved to sample_out if given. A listing that
+	 * fits in it has no cuts then, and is cut at its quantiles otherwise.
+	 * Else the first cut is the last sampled key. Keys past it may diverge
+	 * earlier than the sample does (e.g. numbered keys), so MaxKeys=1
+	 * probes find the stem all keys share and the highest character after
+	 * it, and the rest is cut there over the characters the sample uses.
+	 * A cut never falls inside a common prefix of delim */
+	static std::vector<std::string>
+		SampleCuts(ClusterMap* map, const std::vector<Cluster*>& clusters,
+				const std::string& prefix, const std::string& delim, bool cp,
+				size_t ways, KeyList* sample_out)
+		{
+			struct Probe {
+				KeyList page;
+				bool more;
+			};
+			std::vector<std::future<Probe>> futs;
+			std::vector<KeyList> pages;
+			std::vector<std::string> cuts;
+			std::string after;
+			bool more = false;
 
 			for (auto c : clusters) {
-				Result r = c->ListObjects(objs.get());
-				if (!r.IsSuccess()) {
-					auto err = r.GetErrorType();
-					if (err == Aws::S3::S3Errors::RESOURCE_NOT_FOUND)
-						throw NoSuchResourceError();
+				futs.push_back(std::async(std::launch::async, [map, c, &prefix, &delim, cp]() -> Probe {
+							Objects probe(map, prefix, delim, cp, DSS_SPLIT_PROBE_KEYS);
+							CheckResult(c->ListObjects(&probe));
+							return Probe{std::move(probe.GetPage()), probe.TokenSet()};
+							}));
+			}
+
+			// Wait for all before rethrowing, the tasks reference our locals
+			for (auto& f : futs)
+				f.wait();
+			for (auto& f : futs) {
+				Probe p = f.get();
+				// Past the lowest last key of a truncated page the sample
+				// is incomplete
+				if (p.more && !p.page.empty()) {
+					std::string last = p.page.Get(p.page.size() - 1);
+					if (!more || last < after)
+						after = last;
+					more = true;
+				}
+				pages.push_back(std::move(p.page));
+			}
+
+			// First key past start_after in any cluster, empty if none
+			auto next_key = [map, &clusters, &prefix](const std::string& start_after) {
+				std::vector<std::future<std::string>> fs;
+				std::string next;
+
+				for (auto c : clusters) {
+					fs.push_back(std::async(std::launch::async, [map, c, &prefix, &start_after]() {
+								Objects probe(map, prefix, "", false, 1);
+								probe.SetRange(start_after, "");
+								CheckResult(c->ListObjects(&probe));
+								return probe.GetPage().empty() ? std::string() : probe.GetPage().Get(0);
+								}));
+				}
+				for (auto& f : fs)
+					f.wait();
+				for (auto& f : fs) {
+					std::string k = f.get();
+					if (!k.empty() && (next.empty() || k < next))
+						next = k;
+				}
+
+				return next;
+			};
+
+			KeyList sample = KeyList::Merge(pages, true);
+			auto add = [&prefix, &delim, &cuts](std::string cut) {
+				// Inside a common prefix both neighbouring ranges would
+				// return it, cut before its delimiter instead
+				size_t d = delim.empty() ? std::string::npos : cut.find(delim, prefix.size());
+				if (d != std::string::npos)
+					cut.resize(d);
+				if (cuts.empty() || cuts.back() < cut)
+					cuts.push_back(cut);
+			};
+
+			if (!more && sample_out) {
+				// Listed already
+			} else if (!more) {
+				// The sample is the whole listing, cut at its quantiles
+				for (size_t k = 1; k < ways && !sample.empty(); k++)
+					add(sample.Get(k * sample.size() / ways));
+			} else {
+				std::string first = sample.Get(0);
+				std::vector<size_t> bounds;
+				size_t pos = 0, l, h;
+				unsigned lo = 0, top = 0x7f;
+
+				while (pos < first.size() && pos < after.size() && first[pos] == after[pos])
+					pos++;
+				// Probes must stay valid UTF-8, stems end on a character
+				for (size_t j = prefix.size(); j <= pos; j++)
+					if (j == prefix.size() || j == after.size() ||
+							((unsigned char)after[j] & 0xc0) != 0x80)
+						bounds.push_back(j);
+				for (l = 0, h = bounds.size(); h - l > 1; ) {
+					size_t m = (l + h) / 2;
+					if (next_key(after.substr(0, bounds[m]) + DSS_KEY_MAX_CHAR).empty())
+						l = m;
 					else
-						throw GenericError(r.GetErrorMsg().c_str());
+						h = m;
+				}
+				std::string stem = after.substr(0, bounds[l]);
+
+				if (stem.size() < after.size())
+					lo = (unsigned char)after[stem.size()];
+				// Highest character after the stem, non-ASCII ones all go
+				// to the last range
+				for (unsigned b = lo; top - b > 1 && lo < 0x7f; ) {
+					unsigned m = (b + top) / 2;
+					if (next_key(stem + (char)m + DSS_KEY_MAX_CHAR).empty())
+						top = m;
+					else
+						b = m;
+				}
+
+				// Cut over the characters the sample uses where it varies,
+				// two deep to get enough cuts out of a small alphabet
+				std::vector<char> alpha;
+				bool seen[0x80] = {};
+				for (size_t i = 0; i < sample.size(); i++)
+					for (size_t j = pos; j < sample.Length(i); j++)
+						if ((unsigned char)sample.Data(i)[j] < 0x80)
+							seen[(unsigned char)sample.Data(i)[j]] = true;
+				seen[top] = true;
+				for (unsigned c = lo; c <= top && lo < 0x7f; c++)
+					if (seen[c])
+						alpha.push_back(c);
+
+				add(after);
+				for (size_t k = 1, n = alpha.size(); k < ways && n; k++) {
+					size_t q = k * n * n / ways;
+					std::string cut = stem + alpha[q / n];
+					if (q % n)
+						cut += alpha[q % n];
+					if (cut > after)
+						add(cut);
+				}
+			}
+
+			if (sample_out)
+				*sample_out = std::move(sample);
+
+			return cuts;
+		}
+
+	/* Split one cluster's key space into ranges listed concurrently over
+	 * its endpoints, instead of one continuation-token chain.
+	 *
+	 * A recursive listing whose first "/" level fits in one probe page is
+	 * split by those sub-prefixes. Otherwise it is cut by SampleCuts(),
+	 * the sample standing for the first range and every other range being
+	 * listed from its StartAfter */
+	KeyList
+		Client::ListClusterSplit(Cluster* c, const std::string& prefix,
+				const std::string& delimit, unsigned int ways)
+		{
+			struct Range {
+				std::string prefix;
+				std::string start_after;
+				std::string last;
+			};
+			const std::vector<Endpoint*>& eps = c->GetEndpoints();
+			std::vector<Range> ranges;
+			std::vector<KeyList> lists;
+
+			if (delimit.empty()) {
+				std::unique_ptr<Objects> probe = GetObjects(prefix, "/", true, DSS_SPLIT_PROBE_KEYS);
+				CheckResult(c->ListObjects(probe.get()));
+
+				if (!probe->TokenSet() && probe->GetCPre().size() > 1) {
+					const KeyList& page = probe->GetPage();
+					KeyList top;
+
+					for (size_t i = 0; i < page.size(); i++) {
+						std::string k = page.Get(i);
+						if (!probe->GetCPre().count(k))
+							top.Append(k);
+					}
+					lists.push_back(std::move(top));
+
+					for (auto& cp : probe->GetCPre())
+						ranges.push_back(Range{cp, "", ""});
+				}
+			}
+
+			if (ranges.empty()) {
+				KeyList sample;
+				std::vector<std::string> cuts = SampleCuts(m_cluster_map.get(),
+						std::vector<Cluster*>{c}, prefix, delimit, false, ways, &sample);
+				if (cuts.empty())
+					return sample;
+
+				KeyList first;
+				for (size_t i = 0; i < sample.size(); i++) {
+					std::string k = sample.Get(i);
+					if (k <= cuts[0])
+						first.Append(k);
+				}
+				lists.push_back(std::move(first));
+
+				for (size_t k = 1; k <= cuts.size(); k++)
+					ranges.push_back(Range{prefix, cuts[k - 1], k < cuts.size() ? cuts[k] : ""});
+			}
+
+			std::vector<KeyList> parts(ranges.size());
+			std::vector<std::future<void>> futs;
+			std::atomic<size_t> next(0);
+			std::atomic<bool> failed(false);
+			unsigned workers = std::min<size_t>(ways, ranges.size());
+
+			for (unsigned w = 0; w < workers; w++) {
+				Endpoint* ep = eps[w % eps.size()];
+				futs.push_back(std::async(std::launch::async,
+							[this, c, ep, &delimit, &ranges, &parts, &next, &failed]() {
+							size_t i;
+							while (!failed && (i = next++) < ranges.size()) {
+								std::unique_ptr<Objects> objs =
+									GetObjects(ranges[i].prefix, delimit, false, 0);
+								objs->SetRange(ranges[i].start_after, ranges[i].last);
+								try {
+									CheckResult(ep->ListObjects(c->GetBucket(), objs.get()));
+								} catch (...) {
+									failed = true;
+									throw;
+								}
+								parts[i] = std::move(objs->GetPage());
+							}
+							}));
+			}
+
+			for (auto& f : futs)
+				f.wait();
+			for (auto& f : futs)
+				f.get();
+
+			for (auto& p : parts)
+				lists.push_back(std::move(p));
+
+			return KeyList::Merge(lists, true);
+		}
+
+	/* Clusters are listed concurrently, each into its own sorted key list,
+	 * then merged. Wall time is that of the slowest cluster */
+	KeyList
+		Client::ListObjects(const std::string& prefix, const std::string& delimit,
+				unsigned int split)
+		{
+			const std::vector<Cluster*> clusters = m_cluster_map->GetClusters();
+			std::vector<std::future<KeyList>> futs;
+			std::vector<KeyList> lists;
+
+			for (auto c : clusters) {
+				futs.push_back(std::async(std::launch::async, [this, c, &prefix, &delimit, split]() -> KeyList {
+							if (split > 1)
+								return ListClusterSplit(c, prefix, delimit, split);
+							if (m_opts.listCacheTtlMs)
+								return KeyList(*CachedClusterList(c, prefix, delimit, false));
+
+							// page size 0 walks the whole listing in one call
+							std::unique_ptr<Objects> objs = GetObjects(prefix, delimit, false, 0);
+							CheckResult(c->ListObjects(objs.get()));
+
+							return KeyList(std::move(objs->GetPage()));
+							}));
+			}
+
+			// Wait for all before rethrowing, the tasks reference our locals
+			for (auto& f : futs)
+				f.wait();
+			for (auto& f : futs)
+				lists.push_back(f.get());
+
+			return KeyList::Merge(lists, true);
+		}
+
+	/* Same walk as ListObjects but keeping size, ETag and mtime of every
+	 * object, common prefixes are not included */
+	ObjectInfos
+		Client::ListObjectInfos(const std::string& prefix, const std::string& delimit)
+		{
+			const std::vector<Cluster*> clusters = m_cluster_map->GetClusters();
+			std::vector<std::future<ObjectInfos>> futs;
+			std::vector<ObjectInfos> lists;
+
+			for (auto c : clusters) {
+				futs.push_back(std::async(std::launch::async, [this, c, &prefix, &delimit]() {
+							return ListClusterInfos(c, prefix, delimit, "");
+							}));
+			}
+
+			for (auto& f : futs)
+				f.wait();
+			for (auto& f : futs)
+				lists.push_back(f.get());
+
+			return ObjectInfos::Merge(lists, true);
+		}
+
+	/* Keys are grouped by what precedes the first delimiter after prefix,
+	 * objects directly under prefix are counted under prefix itself.
+	 * Each cluster streams its listing into its own totals. Its keys come
+	 * sorted, so the map is only searched when the group changes */
+	std::map<std::string, PrefixSummary>
+		Client::SummarizePrefix(const std::string& prefix, const std::string& delimit)
+		{
+			using Summary = std::map<std::string, PrefixSummary>;
+			const std::vector<Cluster*> clusters = m_cluster_map->GetClusters();
+			std::vector<std::future<Summary>> futs;
+			Summary total;
+
+			for (auto c : clusters) {
+				futs.push_back(std::async(std::launch::async, [this, c, &prefix, &delimit]() {
+							Summary sum;
+							PrefixSummary* cur = nullptr;
+							std::string group;
+							std::unique_ptr<Objects> objs = GetObjects(prefix, "", false, 0);
+
+							objs->SetVisitor([&](const char* key, size_t len, int64_t size) {
+								size_t end = prefix.size();
+								if (!delimit.empty()) {
+									const char* d = std::search(key + prefix.size(), key + len,
+										delimit.begin(), delimit.end());
+									if (d != key + len)
+										end = d - key + delimit.size();
+								}
+
+								if (!cur || group.compare(0, std::string::npos, key, end)) {
+									group.assign(key, end);
+									cur = &sum[group];
+								}
+								cur->count++;
+								cur->bytes += size;
+								});
+							CheckResult(c->ListObjects(objs.get()));
+
+							return sum;
+							}));
+			}
+
+			for (auto& f : futs)
+				f.wait();
+			for (auto& f : futs) {
+				for (auto& g : f.get()) {
+					PrefixSummary& t = total[g.first];
+					t.count += g.second.count;
+					t.bytes += g.second.bytes;
+				}
+			}
+
+			return total;
+		}
+
+	ListCache::Keys
+		ListCache::Get(uint32_t cluster, const std::string& prefix, const std::string& delim,
+				bool cp, unsigned ttl_ms)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto it = m_entries.find(Key(prefix, delim, cp, cluster));
+
+			if (it == m_entries.end())
+				return nullptr;
+			auto now = std::chrono::steady_clock::now();
+
+			if (now > it->second.expires) {
+				m_entries.erase(it);
+				return nullptr;
+			}
+			// Stored by a client keeping listings longer than this one
+			if (now - it->second.at > std::chrono::milliseconds(ttl_ms))
+				return nullptr;
+
+			return it->second.keys;
+		}
+
+	void
+		ListCache::Put(uint32_t cluster, const std::string& prefix, const std::string& delim,
+				bool cp, Keys keys, uint64_t gen, unsigned ttl_ms)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto now = std::chrono::steady_clock::now();
+
+			if (gen != m_gens[Stripe(prefix)])
+				return;
+
+			// Expired entries are otherwise only dropped when looked up
+			for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+				if (now > it->second.expires)
+					it = m_entries.erase(it);
+				else
+					++it;
+			}
+
+			m_entries[Key(prefix, delim, cp, cluster)] =
+				Entry{std::move(keys), now, now + std::chrono::milliseconds(ttl_ms)};
+		}
+
+	size_t
+		ListCache::Stripe(const std::string& prefix)
+		{
+			uint64_t h = HASH_BASIS;
+
+			for (char c : prefix)
+				h = HashStep(h, c);
+
+			return h % GENS;
+		}
+
+	uint64_t
+		ListCache::Generation(const std::string& prefix)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			return m_gens[Stripe(prefix)];
+		}
+
+	/* Entries are ordered by prefix, so each prefix of key is one lookup.
+	 * The prefix hashes are built up along the key */
+	void
+		ListCache::Invalidate(const std::string& key)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			uint64_t h = HASH_BASIS;
+
+			for (size_t i = 0; i <= key.size(); i++) {
+				// Even when not cached, a listing in flight must not be stored
+				m_gens[h % GENS]++;
+				if (i < key.size())
+					h = HashStep(h, key[i]);
+				if (m_entries.empty())
+					continue;
+
+				std::string p = key.substr(0, i);
+				auto it = m_entries.lower_bound(Key(p, "", false, 0));
+				while (it != m_entries.end() && std::get<0>(it->first) == p)
+					it = m_entries.erase(it);
+			}
+		}
+
+	std::shared_ptr<const KeyList>
+		Client::CachedClusterList(Cluster* c, const std::string& prefix,
+				const std::string& delimit, bool cp)
+		{
+			ListCache& cache = m_cluster_map->GetListCache();
+			ListCache::Keys keys = cache.Get(c->GetID(), prefix, delimit, cp, m_opts.listCacheTtlMs);
+
+			if (keys)
+				return keys;
+
+			uint64_t gen = cache.Generation(prefix);
+			std::unique_ptr<Objects> objs = GetObjects(prefix, delimit, cp, 0);
+			CheckResult(c->ListObjects(objs.get()));
+
+			keys = std::make_shared<const KeyList>(std::move(objs->GetPage()));
+			cache.Put(c->GetID(), prefix, delimit, cp, keys, gen, m_opts.listCacheTtlMs);
+
+			return keys;
+		}
+
+	ObjectInfos
+		Client::ListClusterInfos(Cluster* c, const std::string& prefix,
+				const std::string& delimit, const std::string& start_after)
+		{
+			ObjectInfos infos;
+			std::unique_ptr<Objects> objs = GetObjects(prefix, delimit, false, 0);
+
+			objs->SetInfos(&infos);
+			objs->SetRange(start_after, "");
+			CheckResult(c->ListObjects(objs.get()));
+			infos.MergeRuns(true);
+
+			return infos;
+		}
+
+	/* Without old, every cluster is listed in full. Otherwise only keys
+	 * past each cluster's mark are listed and merged into the old ones */
+	std::unique_ptr<KeyIndex>
+		Client::UpdateKeyIndex(const std::string& path, const std::string& prefix,
+				const KeyIndex* old)
+		{
+			const std::vector<Cluster*> clusters = m_cluster_map->GetClusters();
+			std::map<uint32_t, std::string> marks;
+			std::vector<std::future<ObjectInfos>> futs;
+			std::vector<ObjectInfos> lists;
+
+			if (old) {
+				marks = old->Marks();
+				lists.push_back(old->Load());
+			}
+
+			for (auto c : clusters) {
+				std::string after = marks.count(c->GetID()) ? marks[c->GetID()] : "";
+				futs.push_back(std::async(std::launch::async, [this, c, &prefix, after]() {
+							return ListClusterInfos(c, prefix, "", after);
+							}));
+			}
+
+			for (auto& f : futs)
+				f.wait();
+			for (size_t i = 0; i < futs.size(); i++) {
+				ObjectInfos infos = futs[i].get();
+				if (infos.size())
+					marks[clusters[i]->GetID()] = infos.keys.Get(infos.size() - 1);
+				lists.push_back(std::move(infos));
+			}
+
+			ObjectInfos all = ObjectInfos::Merge(lists, true);
+			if (KeyIndex::Write(path, prefix, all, marks))
+				throw FileIOError("Failed to write key index " + path + ": " + strerror(errno));
+
+			return OpenKeyIndex(path);
+		}
+
+	ObjectStat
+		Client::HeadObject(const std::string& key)
+		{
+			std::unique_ptr<Request> req_guard(new Request(key.c_str()));
+
+			m_cluster_map->GetCluster(req_guard.get());
+			Result r = req_guard->Submit(&Cluster::HeadObject);
+			CheckResult(r);
+
+			return ObjectStat{r.GetContentLengthValue(), Unquote(r.GetETag()), r.GetMTime()};
+		}
+
+	/* Keys are queued per endpoint and every endpoint serves its queue
+	 * with a few workers, results come back in the order of keys */
+	ObjectInfos
+		Client::HeadObjects(const std::vector<std::string>& keys)
+		{
+			struct Queue {
+				Endpoint* ep;
+				Aws::String bucket;
+				std::vector<size_t> idx;
+				std::atomic<size_t> next;
+			};
+			std::vector<std::unique_ptr<Request>> reqs;
+			std::map<Endpoint*, Queue*> by_ep;
+			std::deque<Queue> queues;
+			std::vector<int64_t> sizes(keys.size(), -1), mtimes(keys.size(), 0);
+			std::vector<std::string> etags(keys.size());
+			std::vector<std::future<Result>> futs;
+			std::atomic<bool> failed(false);
+			Result res(true);
+			ObjectInfos infos;
+
+			for (size_t i = 0; i < keys.size(); i++) {
+				reqs.emplace_back(new Request(keys[i].c_str()));
+				m_cluster_map->GetCluster(reqs[i].get());
+
+				Endpoint* ep = reqs[i]->cluster->GetEndpoint(reqs[i].get());
+				Queue*& q = by_ep[ep];
+				if (!q) {
+					queues.emplace_back();
+					q = &queues.back();
+					q->ep = ep;
+					q->bucket = reqs[i]->cluster->GetBucket();
+					q->next = 0;
 				}
+				q->idx.push_back(i);
 			}
 
-			return std::move(objs->GetPage());
+			// One bounded pool, worker w starts on queue w and moves on to
+			// the next ones as they drain
+			unsigned workers = std::min<size_t>(keys.size(),
+					std::min<size_t>(queues.size() * DSS_PART_WORKERS_PER_EP, DSS_PART_WORKERS));
+			for (unsigned w = 0; w < workers; w++) {
+				futs.push_back(std::async(std::launch::async,
+							[w, &queues, &reqs, &sizes, &mtimes, &etags, &failed]() -> Result {
+							for (size_t k = 0; k < queues.size() && !failed; k++) {
+								Queue& q = queues[(w + k) % queues.size()];
+								size_t j;
+								while (!failed && (j = q.next++) < q.idx.size()) {
+									size_t i = q.idx[j];
+									Result r = q.ep->HeadObject(q.bucket, reqs[i].get());
+
+									if (r.IsSuccess()) {
+										sizes[i] = r.GetContentLengthValue();
+										etags[i] = Unquote(r.GetETag());
+										mtimes[i] = r.GetMTime();
+									} else if (r.GetErrorType() != Aws::S3::S3Errors::RESOURCE_NOT_FOUND &&
+											r.GetErrorType() != Aws::S3::S3Errors::NO_SUCH_KEY) {
+										failed = true;
+										return r;
+									}
+								}
+							}
+							return Result(true);
+							}));
+			}
+
+			for (auto& f : futs) {
+				Result fr = f.get();
+				if (!fr.IsSuccess() && res.IsSuccess())
+					res = std::move(fr);
+			}
+			CheckResult(res);
+
+			for (size_t i = 0; i < keys.size(); i++)
+				infos.Append(keys[i], sizes[i], etags[i], mtimes[i]);
+
+			return infos;
+		}
+
+	std::unique_ptr<KeyIndex>
+		Client::BuildKeyIndex(const std::string& path, const std::string& prefix)
+		{
+			return UpdateKeyIndex(path, prefix, nullptr);
+		}
+
+	/* Picks up keys added after the last build or refresh. Deleted or
+	 * overwritten keys below a mark are not noticed, rebuild for those */
+	std::unique_ptr<KeyIndex>
+		Client::RefreshKeyIndex(const std::string& path)
+		{
+			std::unique_ptr<KeyIndex> old = OpenKeyIndex(path);
+
+			return UpdateKeyIndex(path, old->Prefix(), old.get());
+		}
+
+	std::unique_ptr<KeyIndex>
+		Client::OpenKeyIndex(const std::string& path)
+		{
+			std::unique_ptr<KeyIndex> idx = KeyIndex::Open(path);
+
+			if (!idx)
+				throw FileIOError("Failed to open key index " + path + ": " + strerror(errno));
+
+			return idx;
 		}
 
-	int Objects::GetObjKeys() 
+	int Objects::FetchPage()
 	{
 		const std::vector<Cluster*> clusters = m_cluster_map->GetClusters();
 
-		m_page.clear();
+		const size_t units = m_sharded ? m_units.size() : clusters.size();
+
+		if (m_lister)
+			return FetchCachedPage();
+
+		m_fill.clear();
+
+		if (!units)
+			return -1;
 
 		if (m_cur_id == -1) {
 			m_cur_id = 0;
-		} else if ((unsigned long)m_cur_id == clusters.size()) {
+		} else if ((unsigned long)m_cur_id == units) {
 			m_cur_id = -1;
 			return -1;
 		}
 
 		while (1) {
-			Result r = clusters[m_cur_id]->ListObjects(this);
+			Cluster* c = clusters[m_cur_id];
+			if (m_sharded) {
+				c = clusters[m_units[m_cur_id].cluster];
+				SetRange(m_units[m_cur_id].start_after, m_units[m_cur_id].last);
+			}
+
+			Result r = c->ListObjects(this);
 			if (!r.IsSuccess()) {
 				auto err = r.GetErrorType();
 				if (err == Aws::S3::S3Errors::RESOURCE_NOT_FOUND)
@@ -1016,16 +2654,16 @@ namespace dss {
 					throw GenericError(r.GetErrorMsg().c_str());
 			}
 
-			//pr_debug("cluster %u returns %lu keys\n", m_cur_id, m_page.size());
+			//pr_debug("cluster %u returns %lu keys\n", m_cur_id, m_fill.size());
 
-			if (m_page.size() < GetPageSize()) {
+			if (m_fill.size() < GetPageSize()) {
 				// TODO: It is unclear whether aws sdk would return
 				// # of keys less than pagesize while there are still
 				// leftovers in cluster, so we rely on GetIsTruncated()
 				// which sets token if true;
 				if (!TokenSet()) {
 					m_cur_id += 1;
-					if ((unsigned long)m_cur_id == clusters.size())
+					if ((unsigned long)m_cur_id == units)
 						break;
 				}
 				continue;
@@ -1036,21 +2674,189 @@ namespace dss {
 			}
 		}
 
+		// Tail of one cluster and head of the next are separate runs
+		m_fill.MergeRuns(true);
+
 		return 0;
 	}
 
+	/* The key space is cut into about 4 ranges per rank by SampleCuts(),
+	 * and range k is listed in every cluster by rank k % world_size. No
+	 * two ranks ever request the same page, and a common prefix comes
+	 * from one rank only. Ranks agree on the cuts as long as the listing
+	 * doesn't change while they start */
+	void
+		Objects::SetShard(uint32_t rank, uint32_t world_size)
+		{
+			const std::vector<Cluster*> clusters = m_cluster_map->GetClusters();
+			std::vector<std::string> cuts = SampleCuts(m_cluster_map, clusters, m_prefix,
+					m_delim, true, 4 * (size_t)world_size, nullptr);
+
+			m_sharded = true;
+			m_units.clear();
+			for (size_t k = rank; k <= cuts.size(); k += world_size) {
+				for (uint32_t c = 0; c < clusters.size(); c++)
+					m_units.push_back(ListUnit{c, k ? cuts[k - 1] : "",
+							k < cuts.size() ? cuts[k] : ""});
+			}
+		}
+
+	/* Same paging as FetchPage() over cached cluster listings. Common
+	 * prefixes are still returned once across clusters: in a delimited
+	 * listing every entry holding the delimiter past prefix is one */
+	int Objects::FetchCachedPage()
+	{
+		const std::vector<Cluster*> clusters = m_cluster_map->GetClusters();
+		const bool cps = NeedCommPrefix() && !m_delim.empty();
+
+		m_fill.clear();
+
+		if (m_cur_id == -1) {
+			m_cur_id = 0;
+			m_cached.reset();
+			m_cache_pos = 0;
+		} else if ((unsigned long)m_cur_id == clusters.size()) {
+			m_cur_id = -1;
+			return -1;
+		}
+
+		while ((unsigned long)m_cur_id < clusters.size() &&
+				(!PageSizeSet() || m_fill.size() < GetPageSize())) {
+			if (!m_cached)
+				m_cached = m_lister(clusters[m_cur_id]);
+
+			m_fill.BeginRun();
+			while (m_cache_pos < m_cached->size() &&
+					(!PageSizeSet() || m_fill.size() < GetPageSize())) {
+				const char* k = m_cached->Data(m_cache_pos);
+				uint32_t len = m_cached->Length(m_cache_pos++);
+
+				if (cps && std::search(k + m_prefix.size(), k + len,
+							m_delim.begin(), m_delim.end()) != k + len) {
+					if (!m_cps.insert(std::string(k, len)).second)
+						continue;
+				} else if (!m_filter.Match(k, len, -1)) {
+					continue;
+				}
+				m_fill.Append(k, len);
+			}
+
+			if (m_cache_pos == m_cached->size()) {
+				m_cur_id += 1;
+				m_cached.reset();
+				m_cache_pos = 0;
+			}
+		}
+
+		m_fill.MergeRuns(true);
+
+		return 0;
+	}
+
+	int Objects::GetObjKeys()
+	{
+		if (!m_prefetch) {
+			int r = FetchPage();
+			m_page.swap(m_fill);
+			return r;
+		}
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (!m_worker.joinable()) {
+			m_done = false;
+			m_stop = false;
+			m_worker = std::thread(&Objects::Prefetch, this);
+		}
+
+		m_cv.wait(lock, [this]() { return !m_ready.empty() || m_done; });
+		if (!m_ready.empty()) {
+			m_page = std::move(m_ready.front());
+			m_ready.pop_front();
+			m_cv.notify_all();
+			return 0;
+		}
+
+		// Worker is finished and every page has been handed out
+		lock.unlock();
+		m_worker.join();
+		m_page.clear();
+		if (m_error) {
+			std::exception_ptr e = m_error;
+			m_error = nullptr;
+			std::rethrow_exception(e);
+		}
+
+		return -1;
+	}
+
+	void Objects::Prefetch()
+	{
+		try {
+			while (FetchPage() == 0) {
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_cv.wait(lock, [this]() { return m_ready.size() < m_prefetch || m_stop; });
+				if (m_stop)
+					break;
+				m_ready.push_back(std::move(m_fill));
+				m_fill.clear();
+				m_cv.notify_all();
+			}
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_error = std::current_exception();
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_done = true;
+		m_cv.notify_all();
+	}
+
+	Objects::~Objects()
+	{
+		if (m_worker.joinable()) {
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stop = true;
+				m_cv.notify_all();
+			}
+			m_worker.join();
+		}
+	}
+
 	std::unique_ptr<Objects>
 		Client::GetObjects(std::string prefix, std::string delimiter, bool cp,
-				uint32_t page_size) {
-			return std::unique_ptr<Objects>(new Objects(m_cluster_map, prefix, delimiter, cp, page_size));
+				uint32_t page_size, uint32_t prefetch, const ListFilter& filter,
+				uint32_t rank, uint32_t world_size) {
+			std::unique_ptr<Objects> objs(new Objects(m_cluster_map.get(), prefix, delimiter, cp,
+						page_size, prefetch));
+
+			objs->SetFilter(filter);
+			if (world_size > 1) {
+				if (rank >= world_size)
+					throw GenericError("rank must be lower than world_size");
+				objs->SetShard(rank, world_size);
+			}
+
+			// Cached listings only hold keys, sizes need a fresh listing.
+			// Shards list only their own ranges
+			if (m_opts.listCacheTtlMs && !filter.HasSizeBounds() && world_size <= 1) {
+				objs->SetLister([this, prefix, delimiter, cp](Cluster* c) {
+						return CachedClusterList(c, prefix, delimiter, cp);
+						});
+			}
+
+			return objs;
 		};
 
 	Client::Client(const std::string& url, const std::string& user, const std::string& pwd,
 			const SesOptions& opts) {
+		m_url = url;
+		m_opts = opts;
 		m_cfg = ExtractOptions(opts);
 		m_cred = Aws::Auth::AWSCredentials(user.c_str(), pwd.c_str());
-		m_discover_ep = new Endpoint(m_cred, url, m_cfg);
-		m_cluster_map = nullptr;
+		m_warmup_ms = 0;
+		m_pool = std::make_shared<BufferPool>(m_opts.bufferPoolMaxSize,
+				m_opts.bufferPoolPerClass, m_opts.bufferPoolHugePages);
 	}
 
 	std::unique_ptr<Client>
@@ -1064,16 +2870,16 @@ namespace dss {
 				return nullptr;
 			}
 
+			if (options.warmupConnections > 0)
+				client->WarmupConnections(options.warmupConnections);
+
 			return client;
 		}
 
 	Client::~Client()
 	{
-		delete m_discover_ep;
-		// There could be the case when client is
-		// destroyed before cluster_map is init'd
-		if (m_cluster_map)
-			delete m_cluster_map;
+		// Endpoints and the cluster map may be shared with other
+		// clients, the last one holding them frees them
 	}
 
 } // namespace dss
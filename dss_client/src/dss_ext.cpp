@@ -35,6 +35,7 @@
 #include <pybind11/functional.h>
 
 #include "dss.h"
+#include "dss_bufpool.h"
 
 using namespace dss;
 
@@ -55,6 +56,18 @@ struct AsyncCtx {
 	std::string& getErrMsg()	{ return msg; }
 };
 
+/* numpy view on memory that is mapped read-only, so it must not be writable */
+template <typename T>
+static py::array_t<T>
+ReadOnlyArray(size_t n, const T* data, py::handle base)
+{
+	py::array_t<T> a(n, data, base);
+
+	py::detail::array_proxy(a.ptr())->flags &= ~py::detail::npy_api::NPY_ARRAY_WRITEABLE_;
+
+	return a;
+}
+
 PYBIND11_MODULE(dss, m) {
 	m.doc() = "provides a key-value API against Samsung DSS clusters";
 	m.def("getVer", []() {
@@ -82,7 +95,25 @@ PYBIND11_MODULE(dss, m) {
 		.def_readwrite("requestTimeoutMs", &SesOptions::requestTimeoutMs)
 		.def_readwrite("connectTimeoutMs", &SesOptions::connectTimeoutMs)
 		.def_readwrite("enableTcpKeepAlive", &SesOptions::enableTcpKeepAlive)
-		.def_readwrite("tcpKeepAliveIntervalMs", &SesOptions::tcpKeepAliveIntervalMs);
+		.def_readwrite("tcpKeepAliveIntervalMs", &SesOptions::tcpKeepAliveIntervalMs)
+		.def_readwrite("warmupConnections", &SesOptions::warmupConnections)
+		.def_readwrite("shareEndpoints", &SesOptions::shareEndpoints)
+		.def_readwrite("rack", &SesOptions::rack)
+		.def_readwrite("subnet", &SesOptions::subnet)
+		.def_readwrite("zone", &SesOptions::zone)
+		.def_readwrite("localInterfaces", &SesOptions::localInterfaces)
+		.def_readwrite("listCacheTtlMs", &SesOptions::listCacheTtlMs)
+		.def_readwrite("directIO", &SesOptions::directIO)
+		.def_readwrite("fileBlockSize", &SesOptions::fileBlockSize)
+		.def_readwrite("atomicDownload", &SesOptions::atomicDownload)
+		.def_readwrite("rangedGetThreshold", &SesOptions::rangedGetThreshold)
+		.def_readwrite("rangedGetPartSize", &SesOptions::rangedGetPartSize)
+		.def_readwrite("multipartThreshold", &SesOptions::multipartThreshold)
+		.def_readwrite("multipartPartSize", &SesOptions::multipartPartSize)
+		.def_readwrite("multipartRetries", &SesOptions::multipartRetries)
+		.def_readwrite("bufferPoolMaxSize", &SesOptions::bufferPoolMaxSize)
+		.def_readwrite("bufferPoolPerClass", &SesOptions::bufferPoolPerClass)
+		.def_readwrite("bufferPoolHugePages", &SesOptions::bufferPoolHugePages);
 
 	m.def("createClient", &Client::CreateClient,
 			py::arg("url"),
@@ -97,6 +128,10 @@ PYBIND11_MODULE(dss, m) {
 				py::arg("key"),
 				py::arg("file_path"),
 				py::arg("async") = false)
+		.def("putObjectBuffers", &Client::PutObjectBuffers,
+				"Upload object whose content is the concatenation of a list of buffers",
+				py::arg("key"),
+				py::arg("buffers"))
 		.def("putObjectBuffer", &Client::PutObjectBuffer,
 				"Upload object from bytearray buffer to dss cluster",
 				py::arg("key"),
@@ -123,6 +158,26 @@ PYBIND11_MODULE(dss, m) {
 				py::arg("key"),
 				py::arg("file_path"))
 
+		.def("getObjectMapped", &Client::GetObjectMapped,
+				"Download object to file through a memory mapping of the file",
+				py::arg("key"),
+				py::arg("file_path"),
+				py::call_guard<py::gil_scoped_release>())
+
+		.def("getObjectBuffers", &Client::GetObjectBuffers,
+				"Download object across a list of buffers filled in order. Returns actual data length",
+				py::arg("key"),
+				py::arg("buffers"))
+
+		.def("getObjectPooled", &Client::GetObjectPooled,
+				"Download object of at most size bytes into a buffer from the client's pool",
+				py::arg("key"),
+				py::arg("size"))
+
+		.def("getObjectSized", &Client::GetObjectSized,
+				"Download object into a buffer allocated at the object's size",
+				py::arg("key"))
+
 		.def("getObjectBuffer", &Client::GetObjectBuffer,
 				"Download object to bytearray buffer from dss cluster. Returns actual data length in the buffer",
 				py::arg("key"),
@@ -133,16 +188,69 @@ PYBIND11_MODULE(dss, m) {
 				py::arg("key"),
 				py::arg("numpy_buffer"))
 
+		.def("warmupConnections", &Client::WarmupConnections,
+				"Open keep-alive connections to every endpoint in parallel. Returns elapsed ms",
+				py::arg("count"),
+				py::call_guard<py::gil_scoped_release>())
+		.def("getWarmupTime", &Client::GetWarmupTime,
+				"Duration in ms of the last connection warm-up, 0 if none")
+
 		.def("deleteObject", &Client::DeleteObject, "Delete object from dss cluster",
 				py::arg("key"))
 		.def("listObjects", &Client::ListObjects, "List object keys with prefix",
 				py::arg("prefix") = "",
-				py::arg("delimiter") = "")
-		.def("getObjects", &Client::GetObjects, "Create a iterable key list",
+				py::arg("delimiter") = "",
+				py::arg("split") = 0,
+				py::call_guard<py::gil_scoped_release>())
+		.def("listObjectInfos", &Client::ListObjectInfos,
+				"List objects with prefix along with their size, etag and mtime",
+				py::arg("prefix") = "",
+				py::arg("delimiter") = "",
+				py::call_guard<py::gil_scoped_release>())
+		.def("summarizePrefix", &Client::SummarizePrefix,
+				"Count objects and bytes under prefix, per common prefix",
+				py::arg("prefix") = "",
+				py::arg("delimiter") = "/",
+				py::call_guard<py::gil_scoped_release>())
+		.def("headObject", &Client::HeadObject,
+				"Size, etag and mtime of an object without downloading it",
+				py::arg("key"),
+				py::call_guard<py::gil_scoped_release>())
+		.def("headObjects", &Client::HeadObjects,
+				"Size, etag and mtime of many objects, size -1 for missing ones",
+				py::arg("keys"),
+				py::call_guard<py::gil_scoped_release>())
+		.def("buildKeyIndex", &Client::BuildKeyIndex,
+				"List every object under prefix into a key index file and map it",
+				py::arg("path"),
+				py::arg("prefix") = "",
+				py::call_guard<py::gil_scoped_release>())
+		.def("refreshKeyIndex", &Client::RefreshKeyIndex,
+				"Add the objects listed after the index's marks and map it again",
+				py::arg("path"),
+				py::call_guard<py::gil_scoped_release>())
+		.def("getObjects", [](Client& c, std::string prefix, std::string delimiter, bool cp,
+					uint32_t limit, uint32_t prefetch, const std::vector<std::string>& suffix,
+					const std::string& glob, const std::string& regex,
+					int64_t min_size, int64_t max_size, uint32_t rank, uint32_t world_size) {
+				return c.GetObjects(prefix, delimiter, cp, limit, prefetch,
+						ListFilter(suffix, glob, regex, min_size, max_size), rank, world_size);
+				}, "Create a iterable key list",
 				py::arg("prefix") = "",
 				py::arg("delimiter") = "",
 				py::arg("common_prefix") = false,
-				py::arg("limit") = DSS_PAGINATION_DEFAULT);
+				py::arg("limit") = DSS_PAGINATION_DEFAULT,
+				py::arg("prefetch") = 0,
+				py::arg("suffix") = std::vector<std::string>(),
+				py::arg("glob") = "",
+				py::arg("regex") = "",
+				py::arg("min_size") = -1,
+				py::arg("max_size") = -1,
+				py::arg("rank") = 0,
+				py::arg("world_size") = 1,
+				// The iterator's lister and prefetch thread use the client
+				py::keep_alive<0, 1>(),
+				py::call_guard<py::gil_scoped_release>());
 
 	class NoIterator : std::exception {
 		public:
@@ -177,9 +285,96 @@ PYBIND11_MODULE(dss, m) {
 			}
 			});
 
+	py::class_<KeyList>(m, "KeyList")
+		.def("__len__", &KeyList::size)
+		.def("__getitem__", [](const KeyList& l, ssize_t i) {
+				if (i < 0)
+				i += l.size();
+				if (i < 0 || (size_t)i >= l.size())
+				throw py::index_error();
+				return l.Get(i);
+				})
+		.def("__iter__", [](const KeyList& l) {
+				return py::make_iterator(l.begin(), l.end());
+				}, py::keep_alive<0, 1>());
+
+	/* sizes and mtimes are numpy views on the columns, they keep the
+	 * ObjectInfos alive instead of copying */
+	py::class_<ObjectInfos>(m, "ObjectInfos")
+		.def("__len__", &ObjectInfos::size)
+		.def_property_readonly("keys", [](ObjectInfos& o) -> KeyList& { return o.keys; },
+				py::return_value_policy::reference_internal)
+		.def_property_readonly("etags", [](ObjectInfos& o) -> KeyList& { return o.etags; },
+				py::return_value_policy::reference_internal)
+		.def_property_readonly("sizes", [](py::object self) {
+				ObjectInfos* o = self.cast<ObjectInfos*>();
+				return py::array_t<int64_t>(o->sizes.size(), o->sizes.data(), self);
+				})
+		.def_property_readonly("mtimes", [](py::object self) {
+				ObjectInfos* o = self.cast<ObjectInfos*>();
+				return py::array_t<int64_t>(o->mtimes.size(), o->mtimes.data(), self);
+				});
+
+	py::class_<ObjectStat>(m, "ObjectStat")
+		.def_readonly("size", &ObjectStat::size)
+		.def_readonly("etag", &ObjectStat::etag)
+		.def_readonly("mtime", &ObjectStat::mtime);
+
+	py::class_<PrefixSummary>(m, "PrefixSummary")
+		.def_readonly("count", &PrefixSummary::count)
+		.def_readonly("bytes", &PrefixSummary::bytes);
+
+	// Goes back to the client's pool once it and every view of it are gone
+	py::class_<PoolBuffer, std::shared_ptr<PoolBuffer>>(m, "PoolBuffer", py::buffer_protocol())
+		.def_buffer([](PoolBuffer& b) {
+				return py::buffer_info(b.Data(), 1, py::format_descriptor<uint8_t>::format(), 1,
+						{(ssize_t)b.Size()}, {1});
+				})
+		.def("__len__", &PoolBuffer::Size)
+		.def_property_readonly("capacity", &PoolBuffer::Capacity)
+		.def("numpy", [](py::object self) {
+				PoolBuffer* b = self.cast<PoolBuffer*>();
+				return py::array_t<uint8_t>(b->Size(), b->Data(), self);
+				}, "Numpy array over the data, holding the buffer");
+
+	py::class_<KeyIndex>(m, "KeyIndex")
+		.def("__len__", &KeyIndex::size)
+		.def("__getitem__", [](const KeyIndex& idx, ssize_t i) {
+				if (i < 0)
+				i += idx.size();
+				if (i < 0 || (size_t)i >= idx.size())
+				throw py::index_error();
+				return idx.Get(i);
+				})
+		.def("__iter__", [](const KeyIndex& idx) {
+				return py::make_iterator(idx.begin(), idx.end());
+				}, py::keep_alive<0, 1>())
+		.def("find", &KeyIndex::Find, "Position of key in the index, -1 if absent",
+				py::arg("key"))
+		.def("etag", &KeyIndex::ETag, py::arg("index"))
+		.def_property_readonly("prefix", &KeyIndex::Prefix)
+		.def_property_readonly("marks", &KeyIndex::Marks)
+		.def_property_readonly("sizes", [](py::object self) {
+				KeyIndex* idx = self.cast<KeyIndex*>();
+				return ReadOnlyArray(idx->size(), idx->Sizes(), self);
+				})
+		.def_property_readonly("mtimes", [](py::object self) {
+				KeyIndex* idx = self.cast<KeyIndex*>();
+				return ReadOnlyArray(idx->size(), idx->MTimes(), self);
+				});
+
+	m.def("openKeyIndex", &Client::OpenKeyIndex, "Map a key index file written by buildKeyIndex",
+			py::arg("path"));
+
 	py::class_<Objects>(m, "Objects")
 		.def("__iter__", [](Objects &objs) {
-				if (objs.GetObjKeys() < 0)
+				int r;
+				{
+				// Let other threads run while waiting on the next page
+				py::gil_scoped_release release;
+				r = objs.GetObjKeys();
+				}
+				if (r < 0)
 				throw NoIterator();
 				return py::make_iterator(objs.begin(), objs.end());
 				}, py::keep_alive<0, 1>());
@@ -0,0 +1,443 @@
+/**
+  The Clear BSD License
+
+  Copyright (c) 2022 Samsung Electronics Co., Ltd.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted (subject to the limitations in the disclaimer
+  below) provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of Samsung Electronics Co., Ltd. nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+ NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+
+#include "dss_filesink.h"
+
+namespace dss {
+
+	static int
+		OpenTemp(const std::string& path, std::string& tmp, int flags)
+		{
+			static std::atomic<unsigned> seq(0);
+
+			tmp = path + ".dss." + std::to_string(getpid()) + "." + std::to_string(seq++);
+
+			return open(tmp.c_str(), flags | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+		}
+
+	/* With atomic, a temporary file next to path when a rename can
+	 * safely replace it: a new file, or a regular one of ours with a
+	 * single link. Otherwise, or if the directory can't take the
+	 * temporary file, path itself truncated, leaving tmp empty */
+	static int
+		OpenDest(const std::string& path, std::string& tmp, int flags, bool atomic)
+		{
+			struct stat st;
+			int fd = -1;
+
+			tmp.clear();
+			if (atomic) {
+				if (lstat(path.c_str(), &st) < 0) {
+					if (errno == ENOENT)
+						fd = OpenTemp(path, tmp, flags);
+				} else if (S_ISREG(st.st_mode) && st.st_nlink == 1 && st.st_uid == geteuid()) {
+					fd = OpenTemp(path, tmp, flags);
+					// The replacement keeps the mode of the original
+					if (fd >= 0)
+						(void)fchmod(fd, st.st_mode & 07777);
+				}
+				if (fd >= 0)
+					return fd;
+				tmp.clear();
+			}
+
+			return open(path.c_str(), flags | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+		}
+
+	/* Closes fd, renaming the temporary file if there is one */
+	static int
+		CloseDest(int fd, const std::string& path, const std::string& tmp)
+		{
+			if (tmp.empty())
+				return close(fd);
+
+			if (close(fd) < 0 || rename(tmp.c_str(), path.c_str()) < 0) {
+				int err = errno;
+				unlink(tmp.c_str());
+				errno = err;
+				return -1;
+			}
+
+			return 0;
+		}
+
+	/* Only regular files can be cut, writing to a device has no end */
+	static int
+		CutDest(int fd, uint64_t len)
+		{
+			struct stat st;
+
+			if (fstat(fd, &st) < 0)
+				return -1;
+			if (S_ISREG(st.st_mode) && (uint64_t)st.st_size != len)
+				return ftruncate(fd, len);
+
+			return 0;
+		}
+
+	FileSink::FileSink(size_t block, bool direct, bool atomic) :
+		m_block(std::max(DSS_FILESINK_ALIGN,
+					(block + DSS_FILESINK_ALIGN - 1) / DSS_FILESINK_ALIGN * DSS_FILESINK_ALIGN)),
+		m_direct(direct),
+		m_atomic(atomic),
+		m_buf(nullptr),
+		m_fd(-1),
+		m_err(0),
+		m_off(0)
+	{
+		if (posix_memalign((void**)&m_buf, DSS_FILESINK_ALIGN, m_block)) {
+			m_buf = nullptr;
+			m_err = ENOMEM;
+			return;
+		}
+		setp(m_buf, m_buf + m_block);
+	}
+
+	FileSink::~FileSink()
+	{
+		if (m_fd >= 0) {
+			close(m_fd);
+			if (!m_tmp.empty())
+				unlink(m_tmp.c_str());
+		}
+		free(m_buf);
+	}
+
+	int
+		FileSink::Open(const std::string& path)
+		{
+			if (m_err) {
+				errno = m_err;
+				return -1;
+			}
+
+			m_path = path;
+			m_fd = OpenDest(path, m_tmp, O_WRONLY, m_atomic);
+			if (m_fd < 0)
+				return -1;
+
+			// Not every filesystem takes O_DIRECT (e.g. tmpfs), write buffered there
+			if (m_direct) {
+				int fl = fcntl(m_fd, F_GETFL);
+				if (fl < 0 || fcntl(m_fd, F_SETFL, fl | O_DIRECT) < 0)
+					m_direct = false;
+			}
+
+			return 0;
+		}
+
+	void
+		FileSink::Preallocate(long long size)
+		{
+			// Best effort, ENOSPC shows up on write anyway
+			if (m_fd >= 0 && size > 0)
+				(void)fallocate(m_fd, 0, 0, size);
+		}
+
+	void
+		FileSink::Reset()
+		{
+			m_off = 0;
+			m_err = 0;
+			setp(m_buf, m_buf + m_block);
+		}
+
+	bool
+		FileSink::WriteOut(const char* p, size_t n)
+		{
+			while (n) {
+				ssize_t r = pwrite(m_fd, p, n, m_off);
+				if (r < 0) {
+					if (errno == EINTR)
+						continue;
+					m_err = errno;
+					return false;
+				}
+				p += r;
+				n -= r;
+				m_off += r;
+			}
+
+			return true;
+		}
+
+	/* Without all, O_DIRECT only writes whole pages and the rest stays
+	 * buffered. With all, the tail goes out after clearing O_DIRECT */
+	bool
+		FileSink::Flush(bool all)
+		{
+			size_t n = pptr() - pbase();
+			size_t k = m_direct ? n / DSS_FILESINK_ALIGN * DSS_FILESINK_ALIGN : n;
+
+			if (m_err || m_fd < 0)
+				return false;
+
+			if (!WriteOut(m_buf, k))
+				return false;
+
+			if (all && k < n) {
+				int fl = fcntl(m_fd, F_GETFL);
+				if (fl < 0 || fcntl(m_fd, F_SETFL, fl & ~O_DIRECT) < 0) {
+					m_err = errno;
+					return false;
+				}
+				m_direct = false;
+				if (!WriteOut(m_buf + k, n - k))
+					return false;
+				k = n;
+			}
+
+			memmove(m_buf, m_buf + k, n - k);
+			setp(m_buf, m_buf + m_block);
+			pbump(n - k);
+
+			return true;
+		}
+
+	FileSink::int_type
+		FileSink::overflow(int_type c)
+		{
+			if (!Flush(false))
+				return traits_type::eof();
+
+			if (!traits_type::eq_int_type(c, traits_type::eof())) {
+				*pptr() = traits_type::to_char_type(c);
+				pbump(1);
+			}
+
+			return traits_type::not_eof(c);
+		}
+
+	/* Whole blocks arriving on an empty buffer skip the copy */
+	std::streamsize
+		FileSink::xsputn(const char* s, std::streamsize n)
+		{
+			std::streamsize done = 0;
+
+			while (done < n) {
+				size_t left = n - done;
+
+				if (pptr() == pbase() && left >= m_block &&
+						(!m_direct || (uintptr_t)(s + done) % DSS_FILESINK_ALIGN == 0)) {
+					size_t len = left / m_block * m_block;
+					if (m_err || m_fd < 0 || !WriteOut(s + done, len))
+						return done;
+					done += len;
+					continue;
+				}
+
+				size_t room = epptr() - pptr();
+				if (!room) {
+					if (!Flush(false))
+						return done;
+					continue;
+				}
+
+				size_t len = std::min(room, left);
+				memcpy(pptr(), s + done, len);
+				pbump(len);
+				done += len;
+			}
+
+			return n;
+		}
+
+	int
+		FileSink::sync()
+		{
+			return Flush(false) ? 0 : -1;
+		}
+
+	int
+		FileSink::Commit()
+		{
+			if (!Flush(true)) {
+				errno = m_err ? m_err : EBADF;
+				return -1;
+			}
+
+			// Preallocation may have reserved more than was received
+			if (CutDest(m_fd, m_off) < 0) {
+				m_err = errno;
+				return -1;
+			}
+
+			int fd = m_fd;
+			m_fd = -1;
+
+			return CloseDest(fd, m_path, m_tmp);
+		}
+
+	FileMap::FileMap(bool atomic) :
+		m_data(nullptr),
+		m_size(0),
+		m_fd(-1),
+		m_atomic(atomic),
+		m_anon(false)
+	{
+	}
+
+	FileMap::~FileMap()
+	{
+		if (m_data)
+			munmap(m_data, m_size);
+		if (m_fd >= 0) {
+			close(m_fd);
+			if (!m_tmp.empty())
+				unlink(m_tmp.c_str());
+		}
+	}
+
+	int
+		FileMap::Open(const std::string& path, size_t size)
+		{
+			struct stat st;
+			int prot = PROT_READ | PROT_WRITE;
+			void* p;
+
+			m_path = path;
+			m_fd = OpenDest(path, m_tmp, O_RDWR, m_atomic);
+			if (m_fd < 0 || fstat(m_fd, &st) < 0)
+				return -1;
+			m_anon = !S_ISREG(st.st_mode);
+
+			// Blocks must exist before the pages are dirtied, a sparse
+			// file running out of space would SIGBUS instead of failing
+			if (size && !m_anon && fallocate(m_fd, 0, 0, size) < 0 &&
+					(errno != EOPNOTSUPP || ftruncate(m_fd, size) < 0))
+				return -1;
+
+			// mmap() refuses zero length, an empty object needs no mapping
+			if (!size)
+				return 0;
+
+			if (m_anon)
+				p = mmap(nullptr, size, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			else
+				p = mmap(nullptr, size, prot, MAP_SHARED, m_fd, 0);
+			if (p == MAP_FAILED)
+				return -1;
+			m_data = (unsigned char*)p;
+			m_size = size;
+			(void)madvise(m_data, m_size, MADV_SEQUENTIAL);
+
+			return 0;
+		}
+
+	int
+		FileMap::Commit(size_t len)
+		{
+			size_t off = 0;
+
+			if (m_fd < 0) {
+				errno = EBADF;
+				return -1;
+			}
+
+			while (m_anon && off < len) {
+				ssize_t r = write(m_fd, m_data + off, len - off);
+				if (r < 0 && errno != EINTR)
+					return -1;
+				if (r > 0)
+					off += r;
+			}
+
+			if (m_data) {
+				munmap(m_data, m_size);
+				m_data = nullptr;
+			}
+
+			if (!m_anon && CutDest(m_fd, len) < 0)
+				return -1;
+
+			int fd = m_fd;
+			m_fd = -1;
+
+			return CloseDest(fd, m_path, m_tmp);
+		}
+
+	FileSource::FileSource() :
+		m_data(nullptr),
+		m_size(0)
+	{
+	}
+
+	FileSource::~FileSource()
+	{
+		if (m_data)
+			munmap(m_data, m_size);
+	}
+
+	int
+		FileSource::Open(const std::string& path)
+		{
+			struct stat st;
+			int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+			if (fd < 0)
+				return -1;
+			if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+				int err = S_ISREG(st.st_mode) ? errno : EINVAL;
+				close(fd);
+				errno = err;
+				return -1;
+			}
+
+			// The mapping outlives the descriptor
+			if (st.st_size) {
+				void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+				if (p == MAP_FAILED) {
+					int err = errno;
+					close(fd);
+					errno = err;
+					return -1;
+				}
+				m_data = (unsigned char*)p;
+				m_size = st.st_size;
+				(void)madvise(m_data, m_size, MADV_SEQUENTIAL);
+			}
+			close(fd);
+
+			return 0;
+		}
+
+} // namespace dss
@@ -0,0 +1,150 @@
+/**
+  The Clear BSD License
+
+  Copyright (c) 2022 Samsung Electronics Co., Ltd.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted (subject to the limitations in the disclaimer
+  below) provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of Samsung Electronics Co., Ltd. nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+ NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#ifndef DSS_FILESINK_H
+#define DSS_FILESINK_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <streambuf>
+#include <string>
+
+#define DSS_FILESINK_ALIGN		4096UL
+#define DSS_FILESINK_BLOCK		(4UL << 20)
+
+namespace dss {
+
+	/* Response body sink writing straight to a file with pwrite() of
+	 * block-sized, page-aligned chunks instead of going through an
+	 * fstream. The destination is truncated and written in place.
+	 *
+	 * With atomic, a regular destination (or a new one) is written as a
+	 * temporary file next to it, which Commit() renames over it, so a
+	 * failed download never leaves a truncated file behind. Devices,
+	 * symlinks, hard linked files and files of other owners are still
+	 * written in place, a rename would replace them.
+	 *
+	 * With direct, the file is opened O_DIRECT (if the filesystem allows)
+	 * and only whole aligned blocks are written that way, the unaligned
+	 * tail is written after O_DIRECT is cleared.
+	 *
+	 * Open() and Commit() return -1 with errno set on failure */
+	class FileSink : public std::streambuf {
+		public:
+			FileSink(size_t block = DSS_FILESINK_BLOCK, bool direct = false,
+					bool atomic = false);
+			~FileSink();
+
+			int Open(const std::string& path);
+			/* Reserve the file's extent up front, e.g. from Content-Length */
+			void Preallocate(long long size);
+			/* Start over from offset 0, for a retried request */
+			void Reset();
+			int Commit();
+
+			uint64_t Written() const { return m_off; }
+			bool Direct() const { return m_direct; }
+
+		protected:
+			int_type overflow(int_type c) override;
+			std::streamsize xsputn(const char* s, std::streamsize n) override;
+			int sync() override;
+
+		private:
+			bool WriteOut(const char* p, size_t n);
+			bool Flush(bool all);
+
+			size_t m_block;
+			bool m_direct;
+			bool m_atomic;
+			char* m_buf;
+			int m_fd;
+			int m_err;
+			uint64_t m_off;
+			std::string m_path;
+			std::string m_tmp;
+	};
+
+	/* Destination file of a known size mapped shared in memory, so a
+	 * response body copied into Data() lands in the page cache with no
+	 * further copy. Written in place or, with atomic, through a temporary
+	 * file as FileSink does. A destination that can't be mapped (e.g.
+	 * /dev/null) gets the body in anonymous memory, written out by
+	 * Commit().
+	 *
+	 * Open() and Commit() return -1 with errno set on failure */
+	class FileMap {
+		public:
+			FileMap(bool atomic = false);
+			~FileMap();
+
+			int Open(const std::string& path, size_t size);
+			/* Unmaps and, with a temporary file, renames. The file is cut
+			 * to len (<= Size()) */
+			int Commit(size_t len);
+
+			unsigned char* Data() { return m_data; }
+			size_t Size() const { return m_size; }
+
+		private:
+			unsigned char* m_data;
+			size_t m_size;
+			int m_fd;
+			bool m_atomic;
+			bool m_anon;
+			std::string m_path;
+			std::string m_tmp;
+	};
+
+	/* Source file of an upload mapped read-only, the SDK reads the body
+	 * straight from the page cache. Truncating the file while it is
+	 * mapped faults the reader, as with any mmap.
+	 *
+	 * Open() returns -1 with errno set on failure */
+	class FileSource {
+		public:
+			FileSource();
+			~FileSource();
+
+			int Open(const std::string& path);
+
+			unsigned char* Data() { return m_data; }
+			size_t Size() const { return m_size; }
+
+		private:
+			unsigned char* m_data;
+			size_t m_size;
+	};
+
+} // namespace dss
+
+#endif // DSS_FILESINK_H
@@ -0,0 +1,261 @@
+/**
+  The Clear BSD License
+
+  Copyright (c) 2022 Samsung Electronics Co., Ltd.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted (subject to the limitations in the disclaimer
+  below) provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of Samsung Electronics Co., Ltd. nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+ NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <ostream>
+#include <random>
+#include <string>
+
+#include "dss_filesink.h"
+
+using dss::FileMap;
+using dss::FileSource;
+using dss::FileSink;
+
+static std::string
+read_file(const std::string& path)
+{
+	std::ifstream f(path, std::ios::binary);
+
+	return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+/* Writes data in random sized pieces through an ostream, like the SDK does */
+static void
+write_through(const std::string& path, const std::string& data, size_t block, bool direct,
+		bool prealloc, bool atomic = false)
+{
+	std::mt19937 rng(data.size());
+	FileSink sink(block, direct, atomic);
+	std::ostream os(&sink);
+	size_t off = 0;
+
+	assert(sink.Open(path) == 0);
+	// A retried request starts over
+	os.write("garbage", 7);
+	sink.Reset();
+	if (prealloc)
+		sink.Preallocate(data.size() + 12345);
+
+	while (off < data.size()) {
+		size_t n = std::min<size_t>(data.size() - off, rng() % (3 * block));
+		if (n == 1)
+			os.put(data[off]);
+		else
+			os.write(data.data() + off, n);
+		off += n;
+		if (rng() % 7 == 0)
+			os.flush();
+	}
+	assert(os.good());
+	assert(sink.Commit() == 0);
+	assert(sink.Written() == data.size());
+}
+
+static void
+test_roundtrip()
+{
+	std::mt19937 rng(1);
+	std::string path = "/tmp/dss_filesink_test." + std::to_string(getpid());
+
+	for (size_t size : {0, 1, 4095, 4096, 4097, 1 << 20, (1 << 20) + 333}) {
+		std::string data(size, 0);
+		for (auto& c : data)
+			c = rng();
+
+		for (bool direct : {false, true}) {
+			for (size_t block : {4096, 65536}) {
+				write_through(path, data, block, direct, size % 2, block == 4096);
+				assert(read_file(path) == data);
+			}
+		}
+	}
+
+	unlink(path.c_str());
+}
+
+/* Nothing but the untouched destination is left when not committed */
+static void
+test_abort()
+{
+	std::string path = "/tmp/dss_filesink_test." + std::to_string(getpid());
+	{
+		std::ofstream f(path);
+		f << "old";
+	}
+	{
+		FileSink sink(DSS_FILESINK_BLOCK, false, true);
+		std::ostream os(&sink);
+		assert(sink.Open(path) == 0);
+		os << "partial";
+	}
+	assert(read_file(path) == "old");
+	unlink(path.c_str());
+
+	FileSink sink;
+	assert(sink.Open("/nonexistent/dir/file") < 0 && errno == ENOENT);
+}
+
+/* Destinations a rename would replace are written in place */
+static void
+test_in_place()
+{
+	std::string path = "/tmp/dss_filesink_test." + std::to_string(getpid());
+	std::string link = path + ".link";
+	struct stat st;
+
+	for (bool atomic : {false, true}) {
+		write_through("/dev/null", "discarded", 4096, false, true, atomic);
+		assert(stat("/dev/null", &st) == 0 && S_ISCHR(st.st_mode));
+
+		// Symlink and hard link both still see the new content
+		{
+			std::ofstream f(path);
+			f << "old";
+		}
+		assert(symlink(path.c_str(), link.c_str()) == 0);
+		write_through(link, "via symlink", 4096, false, false, atomic);
+		assert(lstat(link.c_str(), &st) == 0 && S_ISLNK(st.st_mode));
+		assert(read_file(path) == "via symlink");
+		unlink(link.c_str());
+
+		assert(::link(path.c_str(), link.c_str()) == 0);
+		write_through(path, "via hard link", 4096, false, false, atomic);
+		assert(read_file(link) == "via hard link");
+		unlink(link.c_str());
+
+		// The mode of a replaced file is kept
+		assert(chmod(path.c_str(), 0640) == 0);
+		write_through(path, "mode", 4096, false, false, atomic);
+		assert(stat(path.c_str(), &st) == 0 && (st.st_mode & 07777) == 0640);
+		unlink(path.c_str());
+	}
+}
+
+/* Mapped destination, including a short body and an empty object */
+static void
+test_map()
+{
+	std::string path = "/tmp/dss_filesink_test." + std::to_string(getpid());
+	std::string link = path + ".link";
+	struct stat st;
+
+	for (bool atomic : {false, true}) {
+		for (size_t size : {0, 1, 4096, 100000}) {
+			FileMap map(atomic);
+			std::string data(size, 'x');
+
+			assert(map.Open(path, size) == 0);
+			assert(map.Size() == size);
+			for (size_t i = 0; i < size; i++)
+				data[i] = map.Data()[i] = 'a' + i % 26;
+			assert(map.Commit(size / 2) == 0);
+			assert(read_file(path) == data.substr(0, size / 2));
+		}
+
+		// Unmappable and linked destinations are written in place
+		{
+			FileMap map(atomic);
+			assert(map.Open("/dev/null", 5000) == 0);
+			memset(map.Data(), 'n', map.Size());
+			assert(map.Commit(4000) == 0);
+		}
+		assert(stat("/dev/null", &st) == 0 && S_ISCHR(st.st_mode));
+
+		assert(symlink(path.c_str(), link.c_str()) == 0);
+		{
+			FileMap map(atomic);
+			assert(map.Open(link, 3) == 0);
+			memcpy(map.Data(), "sym", 3);
+			assert(map.Commit(3) == 0);
+		}
+		assert(lstat(link.c_str(), &st) == 0 && S_ISLNK(st.st_mode));
+		assert(read_file(path) == "sym");
+		unlink(link.c_str());
+	}
+
+	// Not committed, the previous file stays
+	{
+		std::ofstream f(path);
+		f << "abcdefghij";
+	}
+	{
+		FileMap map(true);
+		assert(map.Open(path, 10) == 0);
+		memcpy(map.Data(), "partial", 7);
+	}
+	assert(read_file(path) == "abcdefghij");
+	unlink(path.c_str());
+}
+
+static void
+test_source()
+{
+	std::string path = "/tmp/dss_filesink_test." + std::to_string(getpid());
+
+	for (size_t size : {0, 1, 4097}) {
+		std::string data(size, 'q');
+		{
+			std::ofstream f(path);
+			f << data;
+		}
+		FileSource src;
+		assert(src.Open(path) == 0);
+		assert(src.Size() == size);
+		assert(std::string((char*)src.Data(), src.Size()) == data);
+	}
+	unlink(path.c_str());
+
+	FileSource src;
+	assert(src.Open("/tmp") < 0 && errno == EINVAL);
+	assert(src.Open(path) < 0 && errno == ENOENT);
+}
+
+int main()
+{
+	test_roundtrip();
+	test_abort();
+	test_in_place();
+	test_map();
+	test_source();
+
+	printf("filesink: all tests passed\n");
+
+	return 0;
+}
@@ -34,11 +34,16 @@
 #define DSS_INTERNAL_H
 
 #include "pr.h"
+#include "json.hpp"
+#include "dss_filesink.h"
+#include "dss_segbuf.h"
+#include "dss_bufpool.h"
 
 namespace dss {
 
 	class Client;
 	class Cluster;
+	class ListCache;
 
 	class CallbackCtx : public Aws::Client::AsyncCallerContext {
 		public:
@@ -55,6 +60,11 @@ namespace dss {
 			void* cb_args;
 	};
 
+	/* Returns the bytes [off, off + len) of an upload's source, either in
+	 * place or copied into scratch, nullptr with errno set on failure */
+	using PartReader = std::function<unsigned char* (long long off, long long len,
+			std::vector<unsigned char>& scratch)>;
+
 	struct Request {
 		typedef Result (Cluster::*Handler) (Request* r);
 		typedef Result (Cluster::*Handler_with_buffer) (Request* r, unsigned char* resp_buff, long long buffer_size);
@@ -81,6 +91,9 @@ namespace dss {
 		uint32_t			key_hash;
 		Cluster*			cluster;
 		std::shared_ptr<Aws::IOStream> io_stream;
+		std::shared_ptr<FileSink> sink;
+		Aws::String			upload_id;
+		ListCache*			list_cache = nullptr;	/* Invalidated again on async completion */
 	};
 
 	class Result {
@@ -96,6 +109,12 @@ namespace dss {
 						" Details: " + e.GetMessage()) {}
 			Result(bool success, long long content_length):
 				r_success(success), r_content_length(content_length) {}
+			Result(bool success, long long content_length, const Aws::String& etag):
+				r_success(success), r_content_length(content_length), r_etag(etag) {}
+			Result(bool success, long long content_length, const Aws::String& etag, int64_t mtime_ms):
+				r_success(success), r_content_length(content_length), r_etag(etag), r_mtime(mtime_ms) {}
+			Result(bool success, Aws::S3::S3Errors type, const Aws::String& msg):
+				r_success(success), r_err_type(type), r_err_msg(msg) {}
 
 			bool IsSuccess() { return r_success; }
 			Aws::IOStream& GetIOStream() { return r_object.GetBody(); }
@@ -103,23 +122,64 @@ namespace dss {
 			long long GetContentLengthValue() { return r_content_length;}
 			Aws::S3::S3Errors GetErrorType() { return r_err_type; }
 			Aws::String& GetErrorMsg() { return r_err_msg; }
+			const Aws::String& GetETag() { return r_etag; }
+			int64_t GetMTime() { return r_mtime; }
 
 		private:
 			bool				r_success;
 			Aws::S3::S3Errors 	r_err_type;
 			Aws::String			r_err_msg;
 			long long           r_content_length;
+			Aws::String			r_etag;
+			int64_t				r_mtime;
 			Aws::S3::Model::GetObjectResult	r_object;
 	};
 
+	/* Installed as the SDK http client factory. Curl clients created
+	 * while a ScopedInterfaceBinding is active on the calling thread
+	 * bind every connection they open to that local interface/address */
+	class DSSHttpClientFactory : public Aws::Http::HttpClientFactory {
+		public:
+			std::shared_ptr<Aws::Http::HttpClient>
+				CreateHttpClient(const Aws::Client::ClientConfiguration& cfg) const override;
+			std::shared_ptr<Aws::Http::HttpRequest>
+				CreateHttpRequest(const Aws::String& uri, Aws::Http::HttpMethod method,
+						const Aws::IOStreamFactory& factory) const override;
+			std::shared_ptr<Aws::Http::HttpRequest>
+				CreateHttpRequest(const Aws::Http::URI& uri, Aws::Http::HttpMethod method,
+						const Aws::IOStreamFactory& factory) const override;
+			void InitStaticState() override;
+			void CleanupStaticState() override;
+	};
+
+	class ScopedInterfaceBinding {
+		public:
+			ScopedInterfaceBinding(const std::string& iface);
+			~ScopedInterfaceBinding();
+	};
+
 	class Endpoint {
 		public:
-			Endpoint(Credentials& cred, const std::string& url, Config& cfg);
+			Endpoint(Credentials& cred, const std::string& url, Config& cfg,
+					const std::vector<std::string>& ifaces = std::vector<std::string>());
 
 			Result GetObject(const Aws::String& bn, Request* req);
 			Result GetObject(const Aws::String& bn, const Aws::String& objectName);
 			Result GetObject(const Aws::String& bn, Request* req, unsigned char* res_buff, long long buffer_size);
 			Result PutObject(const Aws::String& bn, Request* req, unsigned char* res_buff, long long buffer_size);
+			Result HeadObject(const Aws::String& bn, Request* req);
+			Result GetObjectSegments(const Aws::String& bn, Request* req, SegmentStreamBuf* sb);
+			Result GetObjectSized(const Aws::String& bn, Request* req, PoolSink* sink);
+			Result GetObjectRange(const Aws::String& bn, Request* req, unsigned char* buf,
+					long long off, long long len, const Aws::String& etag);
+			Result GetObjectFirstPart(const Aws::String& bn, Request* req, unsigned char* buf,
+					long long len);
+			Result CreateMultipartUpload(const Aws::String& bn, Request* req);
+			Result UploadPart(const Aws::String& bn, Request* req, int part_no,
+					unsigned char* buf, long long len);
+			Result CompleteMultipartUpload(const Aws::String& bn, Request* req,
+					const std::vector<Aws::String>& etags);
+			Result AbortMultipartUpload(const Aws::String& bn, Request* req);
 
 			Result GetObjectAsync(const Aws::String& bn, Request* req);
 			Result PutObject(const Aws::String& bn, Request* req);
@@ -135,7 +195,17 @@ namespace dss {
 			Result ListObjects(const Aws::String& bn, Objects *objs);
 
 		private:
-			Aws::S3::S3Client m_ses;
+			void Connect();
+			Aws::S3::S3Client& Session();
+
+			Credentials m_cred;
+			Config m_cfg;
+			std::vector<std::string> m_ifaces;
+			/* One session per local interface, requests rotate over them */
+			std::vector<std::unique_ptr<Aws::S3::S3Client>> m_ses;
+			std::atomic<unsigned> m_next_ses;
+			std::atomic<unsigned> m_fork_gen;
+			std::mutex m_ses_mutex;
 	};
 
 	class Cluster {
@@ -163,6 +233,14 @@ namespace dss {
 
 			Result GetObject(Request* r);
 			Result GetObjectAsync(Request* r);
+			Result HeadObject(Request* r);
+			Result GetObjectSegments(Request* r, SegmentStreamBuf* sb);
+			Result GetObjectSized(Request* r, PoolSink* sink);
+			Result GetObjectFirstPart(Request* r, unsigned char* buf, long long len);
+			Result GetObjectRanges(Request* r, unsigned char* buf, long long from,
+					long long size, long long part, const Aws::String& etag);
+			Result PutObjectParts(Request* r, long long size, long long part,
+					unsigned retries, const PartReader& read);
 			Result PutObject(Request* r);
 			Result PutObjectAsync(Request* r);
 			Result DeleteObject(Request* r);
@@ -172,11 +250,18 @@ namespace dss {
 
 			Result CreateBucket();
 			uint32_t GetID() { return m_id; }
+			const Aws::String& GetBucket() { return m_bucket; }
+			const std::vector<Endpoint*>& GetEndpoints() { return m_endpoints; }
 
 			Result ListObjects(Objects *objs);
 
 			int InsertEndpoint(Client* c, const std::string& ip, uint32_t port);
 		private:
+			size_t PartWorkers()
+			{
+				return std::min<size_t>(m_endpoints.size() * DSS_PART_WORKERS_PER_EP, DSS_PART_WORKERS);
+			}
+
 			uint32_t m_id;
 			Aws::String m_bucket;
 			std::vector<Endpoint*> m_endpoints;
@@ -191,7 +276,7 @@ namespace dss {
 	 * global, ShutdownAPI() would crash */
 	class DSSInit {
 		public:
-			DSSInit(): m_local_config(nullptr), m_options()
+			DSSInit(): m_local_config(nullptr), m_options(), m_pid(getpid()), m_fork_gen(0)
 		{
 			char *s = NULL;
 			unsigned l = 0;
@@ -216,21 +301,82 @@ namespace dss {
 			if (putenv(s))
 				pr_err("Failed to set AWS_EC2_METADATA_DISABLED\n");
 
+			m_options.httpOptions.httpClientFactory_create_fn = []() {
+				return std::static_pointer_cast<Aws::Http::HttpClientFactory>(
+						Aws::MakeShared<DSSHttpClientFactory>("DSS"));
+			};
+
 			Aws::InitAPI(m_options);
+
+			if (pthread_atfork(AtForkPrepare, AtForkParent, AtForkChild))
+				pr_err("Failed to register fork handlers\n");
 		}
 
 			~DSSInit()
 			{
-				Aws::ShutdownAPI(m_options);
+				// A forked child inherits the parent's SDK state but none of
+				// its threads, tearing it down here could hang or double free
+				if (getpid() == m_pid)
+					Aws::ShutdownAPI(m_options);
 			}
 
 			const char* GetConfPath() { return m_local_config; }
 			std::mutex& mutex() { return m_mutex; }
 
+			/* Bumped in every forked child, so per-process state such
+			 * as S3 sessions knows it has to be rebuilt before use */
+			unsigned ForkGeneration() { return m_fork_gen.load(); }
+
 		private:
+			static void AtForkPrepare();
+			static void AtForkParent();
+			static void AtForkChild();
+
 			std::mutex m_mutex;
 			const char* m_local_config;
 			Aws::SDKOptions m_options;
+			/* The process that called InitAPI(), never updated in a child */
+			pid_t m_pid;
+			std::atomic<unsigned> m_fork_gen;
+	};
+
+	/* Complete cluster listings kept in memory, keyed by (prefix,
+	 * delimiter, common prefixes wanted, cluster). Clients sharing a
+	 * ClusterMap share the cache, each reading with its own TTL, and an
+	 * entry expires by the TTL it was stored with. Writes through
+	 * Invalidate() drop every entry whose prefix covers the key */
+	class ListCache {
+		public:
+			using Keys = std::shared_ptr<const KeyList>;
+
+			ListCache() : m_gens() {}
+
+			Keys Get(uint32_t cluster, const std::string& prefix, const std::string& delim,
+					bool cp, unsigned ttl_ms);
+			/* Dropped if a key under prefix was invalidated since gen was read */
+			void Put(uint32_t cluster, const std::string& prefix, const std::string& delim,
+					bool cp, Keys keys, uint64_t gen, unsigned ttl_ms);
+			void Invalidate(const std::string& key);
+			uint64_t Generation(const std::string& prefix);
+
+		private:
+			/* Generations are striped by a hash of the prefix, a write only
+			 * discards the listings in flight that may cover it */
+			static constexpr size_t GENS = 256;
+			static constexpr uint64_t HASH_BASIS = 14695981039346656037ULL;
+			static uint64_t HashStep(uint64_t h, char c) { return (h ^ (unsigned char)c) * 1099511628211ULL; }
+			static size_t Stripe(const std::string& prefix);
+
+			using Key = std::tuple<std::string, std::string, bool, uint32_t>;
+			struct Entry {
+				Keys keys;
+				std::chrono::steady_clock::time_point at;
+				std::chrono::steady_clock::time_point expires;
+			};
+
+			std::map<Key, Entry> m_entries;
+			uint64_t m_gens[GENS];
+			std::mutex m_mutex;
 	};
 
 	class ClusterMap {
@@ -247,8 +393,8 @@ namespace dss {
 			};
 
 		public:
-			ClusterMap(Client *c, DSSInit& i) :
-				m_wait_time(3), m_client(c), m_init(i) {}
+			ClusterMap(DSSInit& i) :
+				m_wait_time(3), m_init(i) {}
 
 			~ClusterMap()
 			{
@@ -268,11 +414,10 @@ namespace dss {
 
 			void GetCluster(Request* req);
 			const char* GetClusterConfFromLocal() { return m_init.GetConfPath(); }
-			int AcquireClusterConf(const std::string& uuid, const unsigned int endpoints_per_cluster);
+			int AcquireClusterConf(Client* c, const std::string& uuid, const unsigned int endpoints_per_cluster);
+			static unsigned GetLocalityDistance(const SesOptions& opts, const nlohmann::json& ep);
 			int VerifyClusterConf();
 			Status DetectClusterBuckets(bool);
-			Result TryLockClusters();
-			Result UnlockClusters();
 
 			const std::vector<Cluster*>& GetClusters() { return m_clusters; }
 
@@ -292,14 +437,127 @@ namespace dss {
 			}
 
 			unsigned GetEPWeight(unsigned i);
+			ListCache& GetListCache() { return m_list_cache; }
 
 		private:
+			ListCache m_list_cache;
 			unsigned m_wait_time;
-			Client* m_client;
 			DSSInit& m_init;
 			std::hash<std::string> m_hash;
 			std::vector<Cluster*> m_clusters;
 	};
+
+	/* Clients created with the same discovery URL, credentials, UUID,
+	 * endpoint count and transport options share one discovery endpoint
+	 * and one cluster map, so N clients in a process don't open N times
+	 * the sockets to the same servers. Entries go away with the last
+	 * client using them */
+	class SessionRegistry {
+		public:
+			struct Entry {
+				std::shared_ptr<Endpoint> discover_ep;
+				std::shared_ptr<ClusterMap> cluster_map;
+			};
+
+			/* One per key, locked for the whole lookup-or-create so that
+			 * concurrent creators of the same session wait for and reuse
+			 * the first one, without holding up other keys */
+			class Slot {
+				public:
+					std::mutex& mutex() { return m_mutex; }
+
+					bool Find(Entry& e)
+					{
+						e.discover_ep = m_discover_ep.lock();
+						e.cluster_map = m_cluster_map.lock();
+
+						return e.discover_ep && e.cluster_map;
+					}
+
+					void Insert(const Entry& e)
+					{
+						m_discover_ep = e.discover_ep;
+						m_cluster_map = e.cluster_map;
+					}
+
+					bool Expired()
+					{
+						return m_discover_ep.expired() || m_cluster_map.expired();
+					}
+
+				private:
+					std::mutex m_mutex;
+					std::weak_ptr<Endpoint> m_discover_ep;
+					std::weak_ptr<ClusterMap> m_cluster_map;
+			};
+
+			static std::string MakeKey(const std::string& url, Credentials& cred,
+					const SesOptions& opts, const std::string& uuid,
+					unsigned endpoints_per_cluster)
+			{
+				std::string key;
+				// Locality changes which endpoints get selected, the rest
+				// how the endpoints talk to the servers
+				for (auto& s : {url, std::string(cred.GetAWSAccessKeyId().c_str()),
+						std::string(cred.GetAWSSecretKey().c_str()), uuid,
+						std::to_string(endpoints_per_cluster),
+						opts.rack, opts.subnet, opts.zone, opts.scheme,
+						std::to_string(opts.useDualStack),
+						std::to_string(opts.maxConnections),
+						std::to_string(opts.httpRequestTimeoutMs),
+						std::to_string(opts.requestTimeoutMs),
+						std::to_string(opts.connectTimeoutMs),
+						std::to_string(opts.enableTcpKeepAlive),
+						std::to_string(opts.tcpKeepAliveIntervalMs)}) {
+					key.append(s);
+					key.push_back('\0');
+				}
+				for (auto& s : opts.localInterfaces) {
+					key.append(s);
+					key.push_back('\0');
+				}
+
+				return key;
+			}
+
+			std::shared_ptr<Slot> GetSlot(const std::string& key)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				std::shared_ptr<Slot>& slot = m_slots[key];
+
+				if (!slot) {
+					// Drop sessions nobody uses or is creating anymore
+					for (auto it = m_slots.begin(); it != m_slots.end(); ) {
+						if (it->second && it->second.use_count() == 1 && it->second->Expired())
+							it = m_slots.erase(it);
+						else
+							++it;
+					}
+					slot = std::make_shared<Slot>();
+				}
+
+				return slot;
+			}
+
+			/* A slot held by a parent thread at fork() stays locked in
+			 * the child forever, forget it there */
+			void ForkChild()
+			{
+				for (auto it = m_slots.begin(); it != m_slots.end(); ) {
+					if (it->second.use_count() > 1)
+						it = m_slots.erase(it);
+					else
+						++it;
+				}
+			}
+
+			/* Guards the slot map only */
+			std::mutex& mutex() { return m_mutex; }
+
+		private:
+			std::mutex m_mutex;
+			std::map<std::string, std::shared_ptr<Slot>> m_slots;
+	};
 }
 
 #endif // DSS_INTERNAL_H
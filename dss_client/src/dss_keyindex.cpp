@@ -0,0 +1,449 @@
+/**
+  The Clear BSD License
+
+  Copyright (c) 2022 Samsung Electronics Co., Ltd.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted (subject to the limitations in the disclaimer
+  below) provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of Samsung Electronics Co., Ltd. nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+ NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dss_keyindex.h"
+
+namespace dss {
+
+#define DSS_KEYINDEX_MAGIC		"DSSKIDX1"
+#define DSS_KEYINDEX_VERSION	1
+
+	/* All offsets are from the start of the file */
+	struct KeyIndexHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t restart;
+		uint64_t count;
+		uint64_t prefix_off;	// u32 length, bytes
+		uint64_t marks_off;		// u32 n, n * (u32 cluster id, u32 length, bytes)
+		uint64_t sizes_off;		// i64[count]
+		uint64_t mtimes_off;	// i64[count]
+		uint64_t etags_off;		// u64[count + 1] offsets into the bytes that follow
+		uint64_t restarts_off;	// u64[blocks] offsets from keys_off
+		uint64_t keys_off;		// per key: varint shared, varint rest, rest bytes
+		uint64_t keys_end;
+	};
+
+	static uint64_t
+		GetVarint(const uint8_t*& p)
+		{
+			uint64_t v = 0;
+
+			for (unsigned shift = 0; ; shift += 7) {
+				uint8_t b = *p++;
+				v |= (uint64_t)(b & 0x7f) << shift;
+				if (!(b & 0x80))
+					break;
+			}
+
+			return v;
+		}
+
+	/* GetVarint() for untrusted input, false past end or over 64 bits */
+	static bool
+		GetVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v)
+		{
+			v = 0;
+			for (unsigned shift = 0; p < end && shift < 64; shift += 7) {
+				uint8_t b = *p++;
+				v |= (uint64_t)(b & 0x7f) << shift;
+				if (!(b & 0x80))
+					return true;
+			}
+
+			return false;
+		}
+
+	static void
+		PutVarint(std::vector<uint8_t>& out, uint64_t v)
+		{
+			while (v >= 0x80) {
+				out.push_back((uint8_t)(v | 0x80));
+				v >>= 7;
+			}
+			out.push_back((uint8_t)v);
+		}
+
+	/* Sequential fwrite() keeping track of the file offset */
+	class IndexWriter {
+		public:
+			IndexWriter(FILE* f) : m_file(f), m_pos(0), m_failed(false) {}
+
+			void Put(const void* p, size_t n)
+			{
+				if (n && fwrite(p, 1, n, m_file) != n)
+					m_failed = true;
+				m_pos += n;
+			}
+			template <typename T>
+				void PutValue(T v) { Put(&v, sizeof(v)); }
+			void Align(size_t a)
+			{
+				static const char zeros[8] = {0};
+				Put(zeros, (a - m_pos % a) % a);
+			}
+			uint64_t Pos() const { return m_pos; }
+			bool Failed() const { return m_failed; }
+
+		private:
+			FILE* m_file;
+			uint64_t m_pos;
+			bool m_failed;
+	};
+
+	int
+		KeyIndex::Write(const std::string& path, const std::string& prefix,
+				const ObjectInfos& infos, const std::map<uint32_t, std::string>& marks)
+		{
+			std::string tmp = path + ".tmp." + std::to_string(getpid());
+			const KeyList& keys = infos.keys;
+			const size_t count = keys.size();
+			std::vector<uint64_t> restarts;
+			std::vector<uint8_t> coded;
+			KeyIndexHeader h;
+			int err = 0;
+
+			for (size_t i = 0; i < count; i++) {
+				size_t shared = 0;
+
+				if (i % DSS_KEYINDEX_RESTART == 0) {
+					restarts.push_back(coded.size());
+				} else {
+					size_t n = std::min(keys.Length(i - 1), keys.Length(i));
+					while (shared < n && keys.Data(i - 1)[shared] == keys.Data(i)[shared])
+						shared++;
+				}
+				PutVarint(coded, shared);
+				PutVarint(coded, keys.Length(i) - shared);
+				coded.insert(coded.end(), keys.Data(i) + shared, keys.Data(i) + keys.Length(i));
+			}
+
+			FILE* f = fopen(tmp.c_str(), "wb");
+			if (!f)
+				return -1;
+
+			IndexWriter w(f);
+			memset(&h, 0, sizeof(h));
+			w.Put(&h, sizeof(h));
+
+			h.prefix_off = w.Pos();
+			w.PutValue<uint32_t>(prefix.size());
+			w.Put(prefix.data(), prefix.size());
+
+			h.marks_off = w.Pos();
+			w.PutValue<uint32_t>(marks.size());
+			for (auto& m : marks) {
+				w.PutValue<uint32_t>(m.first);
+				w.PutValue<uint32_t>(m.second.size());
+				w.Put(m.second.data(), m.second.size());
+			}
+
+			w.Align(8);
+			h.sizes_off = w.Pos();
+			w.Put(infos.sizes.data(), count * sizeof(int64_t));
+			h.mtimes_off = w.Pos();
+			w.Put(infos.mtimes.data(), count * sizeof(int64_t));
+
+			h.etags_off = w.Pos();
+			uint64_t off = 0;
+			for (size_t i = 0; i < count; i++) {
+				w.PutValue<uint64_t>(off);
+				off += infos.etags.Length(i);
+			}
+			w.PutValue<uint64_t>(off);
+			for (size_t i = 0; i < count; i++)
+				w.Put(infos.etags.Data(i), infos.etags.Length(i));
+
+			w.Align(8);
+			h.restarts_off = w.Pos();
+			w.Put(restarts.data(), restarts.size() * sizeof(uint64_t));
+			h.keys_off = w.Pos();
+			w.Put(coded.data(), coded.size());
+			h.keys_end = w.Pos();
+
+			memcpy(h.magic, DSS_KEYINDEX_MAGIC, sizeof(h.magic));
+			h.version = DSS_KEYINDEX_VERSION;
+			h.restart = DSS_KEYINDEX_RESTART;
+			h.count = count;
+
+			if (w.Failed() || fseek(f, 0, SEEK_SET) || fwrite(&h, sizeof(h), 1, f) != 1 ||
+					fflush(f) || fsync(fileno(f)))
+				err = errno ? errno : EIO;
+			if (fclose(f) && !err)
+				err = errno;
+			if (!err && rename(tmp.c_str(), path.c_str()))
+				err = errno;
+
+			if (err) {
+				unlink(tmp.c_str());
+				errno = err;
+				return -1;
+			}
+
+			return 0;
+		}
+
+	std::unique_ptr<KeyIndex>
+		KeyIndex::Open(const std::string& path)
+		{
+			struct stat st;
+			int fd = open(path.c_str(), O_RDONLY);
+
+			if (fd < 0)
+				return nullptr;
+
+			if (fstat(fd, &st)) {
+				int err = errno;
+				close(fd);
+				errno = err;
+				return nullptr;
+			}
+			if ((size_t)st.st_size < sizeof(KeyIndexHeader)) {
+				close(fd);
+				errno = EINVAL;
+				return nullptr;
+			}
+
+			void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			int err = errno;
+			close(fd);
+			if (map == MAP_FAILED) {
+				errno = err;
+				return nullptr;
+			}
+
+			std::unique_ptr<KeyIndex> idx(new KeyIndex());
+			idx->m_map = map;
+			idx->m_map_len = st.st_size;
+			if (!idx->Parse()) {
+				errno = EINVAL;
+				return nullptr;
+			}
+
+			return idx;
+		}
+
+	KeyIndex::~KeyIndex()
+	{
+		if (m_map)
+			munmap(m_map, m_map_len);
+	}
+
+	/* Check every section lies within the file, and every key entry and
+	 * ETag offset within its section, before handing out pointers. The
+	 * accessors then trust the file */
+	bool
+		KeyIndex::Parse()
+		{
+			const uint8_t* base = (const uint8_t*)m_map;
+			const uint64_t len = m_map_len;
+			KeyIndexHeader h;
+			uint32_t n;
+
+			memcpy(&h, base, sizeof(h));
+			if (memcmp(h.magic, DSS_KEYINDEX_MAGIC, sizeof(h.magic)) ||
+					h.version != DSS_KEYINDEX_VERSION || !h.restart || h.count > len / 8)
+				return false;
+
+			auto fits = [len](uint64_t off, uint64_t n) { return off <= len && n <= len - off; };
+			auto aligned = [](uint64_t off) { return off % 8 == 0; };
+			const uint64_t count = h.count;
+			const uint64_t blocks = (count + h.restart - 1) / h.restart;
+
+			if (!fits(h.prefix_off, 4))
+				return false;
+			memcpy(&n, base + h.prefix_off, 4);
+			if (!fits(h.prefix_off + 4, n))
+				return false;
+			m_prefix.assign((const char*)base + h.prefix_off + 4, n);
+
+			uint64_t off = h.marks_off;
+			uint32_t marks;
+			if (!fits(off, 4))
+				return false;
+			memcpy(&marks, base + off, 4);
+			off += 4;
+			for (uint32_t i = 0; i < marks; i++) {
+				uint32_t id;
+				if (!fits(off, 8))
+					return false;
+				memcpy(&id, base + off, 4);
+				memcpy(&n, base + off + 4, 4);
+				off += 8;
+				if (!fits(off, n))
+					return false;
+				m_marks[id].assign((const char*)base + off, n);
+				off += n;
+			}
+
+			if (!aligned(h.sizes_off) || !fits(h.sizes_off, count * 8) ||
+					!aligned(h.mtimes_off) || !fits(h.mtimes_off, count * 8) ||
+					!aligned(h.etags_off) || !fits(h.etags_off, (count + 1) * 8) ||
+					!aligned(h.restarts_off) || !fits(h.restarts_off, blocks * 8) ||
+					h.keys_off > h.keys_end || h.keys_end > len)
+				return false;
+
+			m_count = count;
+			m_restart = h.restart;
+			m_sizes = (const int64_t*)(base + h.sizes_off);
+			m_mtimes = (const int64_t*)(base + h.mtimes_off);
+			m_etag_offs = (const uint64_t*)(base + h.etags_off);
+			m_etags = (const char*)(base + h.etags_off + (count + 1) * 8);
+			m_restarts = (const uint64_t*)(base + h.restarts_off);
+			m_keys = base + h.keys_off;
+
+			if (!fits(h.etags_off + (count + 1) * 8, m_etag_offs[count]))
+				return false;
+			for (uint64_t i = 0; i < count; i++) {
+				if (m_etag_offs[i] > m_etag_offs[i + 1])
+					return false;
+			}
+
+			// Blocks must follow each other and each key stay in the
+			// section, shared with the previous key at most
+			const uint8_t* p = m_keys;
+			const uint8_t* end = base + h.keys_end;
+			uint64_t prev = 0;
+			for (uint64_t i = 0; i < count; i++) {
+				uint64_t shared, rest;
+
+				if (i % h.restart == 0 && (uint64_t)(p - m_keys) != m_restarts[i / h.restart])
+					return false;
+				if (!GetVarint(p, end, shared) || !GetVarint(p, end, rest) ||
+						shared > (i % h.restart ? prev : 0) || rest > (uint64_t)(end - p))
+					return false;
+				p += rest;
+				prev = shared + rest;
+			}
+
+			return p == end;
+		}
+
+	KeyIndex::const_iterator::const_iterator(const KeyIndex* idx, size_t i) :
+		m_index(idx),
+		m_idx(i),
+		m_pos(nullptr)
+	{
+		if (i >= idx->m_count)
+			return;
+
+		size_t b = i / idx->m_restart;
+		m_pos = idx->Block(b);
+		for (size_t j = b * idx->m_restart; j <= i; j++)
+			Decode();
+	}
+
+	void
+		KeyIndex::const_iterator::Decode()
+		{
+			uint64_t shared = GetVarint(m_pos);
+			uint64_t rest = GetVarint(m_pos);
+
+			m_key.resize(shared);
+			m_key.append((const char*)m_pos, rest);
+			m_pos += rest;
+		}
+
+	/* Blocks are laid out back to back, so the next key is always at m_pos */
+	KeyIndex::const_iterator&
+		KeyIndex::const_iterator::operator++()
+		{
+			if (++m_idx < m_index->m_count)
+				Decode();
+
+			return *this;
+		}
+
+	std::string
+		KeyIndex::Get(size_t i) const
+		{
+			return *const_iterator(this, i);
+		}
+
+	std::string
+		KeyIndex::ETag(size_t i) const
+		{
+			return std::string(m_etags + m_etag_offs[i], m_etag_offs[i + 1] - m_etag_offs[i]);
+		}
+
+	long long
+		KeyIndex::Find(const std::string& key) const
+		{
+			size_t lo = 0, hi = (m_count + m_restart - 1) / m_restart;
+
+			// Last block whose first key is <= key
+			while (hi - lo > 1) {
+				size_t mid = (lo + hi) / 2;
+				const uint8_t* p = Block(mid);
+				GetVarint(p);
+				uint64_t n = GetVarint(p);
+
+				if (KeyList::Compare((const char*)p, n, key.data(), key.size()) <= 0)
+					lo = mid;
+				else
+					hi = mid;
+			}
+
+			const_iterator it(this, lo * m_restart);
+			for (size_t i = lo * m_restart; i < m_count && i < (lo + 1) * m_restart; i++, ++it) {
+				int r = KeyList::Compare((*it).data(), (*it).size(), key.data(), key.size());
+				if (r == 0)
+					return i;
+				if (r > 0)
+					break;
+			}
+
+			return -1;
+		}
+
+	ObjectInfos
+		KeyIndex::Load() const
+		{
+			ObjectInfos out;
+			size_t i = 0;
+
+			for (auto it = begin(); it != end(); ++it, i++)
+				out.Append(*it, m_sizes[i], ETag(i), m_mtimes[i]);
+
+			return out;
+		}
+
+} // namespace dss
@@ -0,0 +1,182 @@
+/**
+  The Clear BSD License
+
+  Copyright (c) 2022 Samsung Electronics Co., Ltd.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted (subject to the limitations in the disclaimer
+  below) provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of Samsung Electronics Co., Ltd. nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+ NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <errno.h>
+#include <unistd.h>
+#include <cassert>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "dss_keyindex.h"
+
+using dss::KeyIndex;
+using dss::ObjectInfos;
+
+static std::string
+tmp_path()
+{
+	return "/tmp/dss_keyindex_test." + std::to_string(getpid());
+}
+
+static ObjectInfos
+random_infos(std::mt19937& rng, size_t n)
+{
+	std::set<std::string> keys;
+	ObjectInfos infos;
+
+	while (keys.size() < n)
+		keys.insert("data/train/img_" + std::to_string(rng() % (n * 10)) +
+				(rng() % 2 ? ".jpg" : "/label"));
+	for (auto& k : keys)
+		infos.Append(k, k.size() * 3, "etag-" + k.substr(k.size() - 3), rng() % 1000);
+
+	return infos;
+}
+
+static void
+test_roundtrip()
+{
+	std::mt19937 rng(3);
+	std::string path = tmp_path();
+
+	for (size_t n : {0, 1, 15, 16, 17, 1000}) {
+		ObjectInfos infos = random_infos(rng, n);
+		std::map<uint32_t, std::string> marks = {{0, "a"}, {3, n ? infos.keys.Get(n - 1) : ""}};
+
+		assert(KeyIndex::Write(path, "data/", infos, marks) == 0);
+		std::unique_ptr<KeyIndex> idx = KeyIndex::Open(path);
+		assert(idx);
+
+		assert(idx->size() == n);
+		assert(idx->Prefix() == "data/");
+		assert(idx->Marks() == marks);
+
+		size_t i = 0;
+		for (auto it = idx->begin(); it != idx->end(); ++it, i++) {
+			assert(*it == infos.keys.Get(i));
+			assert(idx->Get(i) == *it);
+			assert(idx->Size(i) == infos.sizes[i]);
+			assert(idx->MTime(i) == infos.mtimes[i]);
+			assert(idx->ETag(i) == infos.etags.Get(i));
+			assert(idx->Find(*it) == (long long)i);
+		}
+		assert(i == n);
+		assert(idx->Find("") == -1);
+		assert(idx->Find("data/train/img_x") == -1);
+		assert(idx->Find("zzz") == -1);
+
+		ObjectInfos back = idx->Load();
+		assert(back.size() == n && back.sizes == infos.sizes && back.mtimes == infos.mtimes);
+	}
+
+	unlink(path.c_str());
+}
+
+static void
+test_corrupt()
+{
+	std::mt19937 rng(5);
+	std::string path = tmp_path();
+	ObjectInfos infos = random_infos(rng, 100);
+
+	assert(!KeyIndex::Open(path + ".missing") && errno == ENOENT);
+
+	assert(KeyIndex::Write(path, "", infos, {}) == 0);
+	assert(truncate(path.c_str(), 200) == 0);
+	assert(!KeyIndex::Open(path) && errno == EINVAL);
+
+	FILE* f = fopen(path.c_str(), "w");
+	fputs("not an index", f);
+	fclose(f);
+	assert(!KeyIndex::Open(path) && errno == EINVAL);
+
+	unlink(path.c_str());
+}
+
+/* Damaged bytes anywhere are either refused or read within the file */
+static void
+test_damaged()
+{
+	std::mt19937 rng(7);
+	std::string path = tmp_path();
+	ObjectInfos infos = random_infos(rng, 100);
+	std::string good;
+
+	assert(KeyIndex::Write(path, "data/", infos, {{1, "x"}}) == 0);
+	{
+		FILE* f = fopen(path.c_str(), "rb");
+		char buf[4096];
+		size_t n;
+		while ((n = fread(buf, 1, sizeof(buf), f)))
+			good.append(buf, n);
+		fclose(f);
+	}
+
+	for (int round = 0; round < 2000; round++) {
+		std::string bad = good;
+		for (int k = 1 + rng() % 3; k; k--)
+			bad[rng() % bad.size()] = rng();
+
+		FILE* f = fopen(path.c_str(), "wb");
+		fwrite(bad.data(), 1, bad.size(), f);
+		fclose(f);
+
+		std::unique_ptr<KeyIndex> idx = KeyIndex::Open(path);
+		if (!idx) {
+			assert(errno == EINVAL);
+			continue;
+		}
+		size_t i = 0;
+		for (auto it = idx->begin(); it != idx->end(); ++it, i++) {
+			idx->ETag(i);
+			idx->Find(*it);
+		}
+		assert(i == idx->size());
+		idx->Find("data/train/img_5");
+	}
+
+	unlink(path.c_str());
+}
+
+int main()
+{
+	test_roundtrip();
+	test_corrupt();
+	test_damaged();
+
+	printf("keyindex: all tests passed\n");
+
+	return 0;
+}
@@ -0,0 +1,181 @@
+/**
+  The Clear BSD License
+
+  Copyright (c) 2022 Samsung Electronics Co., Ltd.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted (subject to the limitations in the disclaimer
+  below) provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of Samsung Electronics Co., Ltd. nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+ NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include "dss_keylist.h"
+#include "dss_merge.h"
+
+namespace dss {
+
+	void
+		KeyList::MergeRuns(bool dedup, std::vector<size_t>* order)
+		{
+			using It = std::vector<Entry>::const_iterator;
+			std::vector<std::pair<It, It>> runs;
+			std::vector<Entry> merged;
+
+			if (m_runs.empty() || m_runs[0] != 0)
+				m_runs.insert(m_runs.begin(), 0);
+
+			if (m_runs.size() == 1 && !dedup) {
+				m_runs.clear();
+				if (order) {
+					order->resize(m_entries.size());
+					for (size_t i = 0; i < m_entries.size(); i++)
+						(*order)[i] = i;
+				}
+				return;
+			}
+
+			for (size_t i = 0; i < m_runs.size(); i++) {
+				size_t end = i + 1 < m_runs.size() ? m_runs[i + 1] : m_entries.size();
+				runs.emplace_back(m_entries.cbegin() + m_runs[i], m_entries.cbegin() + end);
+			}
+
+			merged.reserve(m_entries.size());
+			if (order) {
+				order->clear();
+				order->reserve(m_entries.size());
+			}
+			KWayMerge(runs, [this, &merged, order](const Entry& e) {
+					merged.push_back(e);
+					if (order)
+						order->push_back(&e - m_entries.data());
+					}, dedup,
+					[this](const Entry& a, const Entry& b) {
+					return Compare(m_arena.data() + a.off, a.len,
+							m_arena.data() + b.off, b.len) < 0;
+					});
+
+			m_entries.swap(merged);
+			m_runs.clear();
+		}
+
+	void
+		KeyList::Select(const std::vector<size_t>& order)
+		{
+			std::vector<Entry> selected;
+
+			selected.reserve(order.size());
+			for (size_t i : order)
+				selected.push_back(m_entries[i]);
+
+			m_entries.swap(selected);
+			m_runs.clear();
+		}
+
+	KeyList
+		KeyList::Concat(std::vector<KeyList>& lists)
+		{
+			KeyList out;
+			size_t bytes = 0, keys = 0;
+
+			for (auto& l : lists) {
+				bytes += l.m_arena.size();
+				keys += l.m_entries.size();
+			}
+			out.m_arena.reserve(bytes);
+			out.m_entries.reserve(keys);
+
+			for (auto& l : lists) {
+				uint64_t base = out.m_arena.size();
+
+				out.BeginRun();
+				out.m_arena.insert(out.m_arena.end(), l.m_arena.begin(), l.m_arena.end());
+				for (auto& e : l.m_entries)
+					out.m_entries.push_back(Entry{base + e.off, e.len});
+				l.clear();
+			}
+
+			return out;
+		}
+
+	/* Each list is a sorted run, their arenas are concatenated once and
+	 * the entries are merged in order */
+	KeyList
+		KeyList::Merge(std::vector<KeyList>& lists, bool dedup, std::vector<size_t>* order)
+		{
+			KeyList out = Concat(lists);
+
+			out.MergeRuns(dedup, order);
+
+			return out;
+		}
+
+	void
+		ObjectInfos::Select(const std::vector<size_t>& order)
+		{
+			std::vector<int64_t> s, m;
+
+			s.reserve(order.size());
+			m.reserve(order.size());
+			for (size_t i : order) {
+				s.push_back(sizes[i]);
+				m.push_back(mtimes[i]);
+			}
+			sizes.swap(s);
+			mtimes.swap(m);
+			etags.Select(order);
+		}
+
+	/* Keys are merged as usual, the other columns follow the same order */
+	void
+		ObjectInfos::MergeRuns(bool dedup)
+		{
+			std::vector<size_t> order;
+
+			keys.MergeRuns(dedup, &order);
+			Select(order);
+		}
+
+	ObjectInfos
+		ObjectInfos::Merge(std::vector<ObjectInfos>& lists, bool dedup)
+		{
+			ObjectInfos out;
+			std::vector<KeyList> keys, etags;
+			std::vector<size_t> order;
+
+			for (auto& l : lists) {
+				keys.push_back(std::move(l.keys));
+				etags.push_back(std::move(l.etags));
+				out.sizes.insert(out.sizes.end(), l.sizes.begin(), l.sizes.end());
+				out.mtimes.insert(out.mtimes.end(), l.mtimes.begin(), l.mtimes.end());
+				l.clear();
+			}
+
+			out.keys = KeyList::Merge(keys, dedup, &order);
+			out.etags = KeyList::Concat(etags);
+			out.Select(order);
+
+			return out;
+		}
+
+} // namespace dss
@@ -0,0 +1,155 @@
+/**
+  The Clear BSD License
+
+  Copyright (c) 2022 Samsung Electronics Co., Ltd.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted (subject to the limitations in the disclaimer
+  below) provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of Samsung Electronics Co., Ltd. nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+ NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "dss_keylist.h"
+
+using dss::KeyList;
+using Keys = std::vector<std::string>;
+
+static Keys
+keys(const KeyList& l)
+{
+	return Keys(l.begin(), l.end());
+}
+
+static void
+test_append()
+{
+	KeyList l;
+
+	assert(l.empty());
+	l.Append("abc");
+	l.Append(std::string("a\0b", 3));
+	assert(l.size() == 2);
+	assert(l.Get(0) == "abc");
+	assert(l.Length(1) == 3 && l.Get(1) == std::string("a\0b", 3));
+
+	l.clear();
+	assert(l.empty() && l.begin() == l.end());
+}
+
+static void
+test_merge_runs()
+{
+	KeyList l;
+
+	l.BeginRun();
+	for (auto& k : Keys{"a/", "c", "d/"})
+		l.Append(k);
+	l.BeginRun();
+	for (auto& k : Keys{"b", "d/", "e"})
+		l.Append(k);
+	/* Empty runs are ignored */
+	l.BeginRun();
+	l.BeginRun();
+
+	KeyList dup = l;
+	dup.MergeRuns(false);
+	assert((keys(dup) == Keys{"a/", "b", "c", "d/", "d/", "e"}));
+
+	l.MergeRuns(true);
+	assert((keys(l) == Keys{"a/", "b", "c", "d/", "e"}));
+}
+
+static void
+test_random()
+{
+	std::mt19937 rng(7);
+
+	for (int iter = 0; iter < 100; iter++) {
+		std::vector<KeyList> lists(rng() % 6);
+		std::set<std::string> uniq;
+
+		for (auto& l : lists) {
+			size_t runs = rng() % 4;
+			for (size_t r = 0; r < runs; r++) {
+				Keys run;
+				size_t n = rng() % 40;
+				for (size_t i = 0; i < n; i++)
+					run.push_back("k" + std::to_string(rng() % 200));
+				std::sort(run.begin(), run.end());
+				l.BeginRun();
+				for (auto& k : run)
+					l.Append(k);
+				uniq.insert(run.begin(), run.end());
+			}
+			l.MergeRuns(true);
+		}
+
+		KeyList all = KeyList::Merge(lists, true);
+		assert(keys(all) == Keys(uniq.begin(), uniq.end()));
+	}
+}
+
+static void
+test_object_infos()
+{
+	std::vector<dss::ObjectInfos> lists(2);
+
+	lists[0].BeginRun();
+	lists[0].Append("b", 2, "e-b", 20);
+	lists[0].Append("d", 4, "e-d", 40);
+	lists[0].BeginRun();
+	lists[0].Append("a", 1, "e-a", 10);
+	lists[0].MergeRuns(true);
+	assert((keys(lists[0].keys) == Keys{"a", "b", "d"}));
+	assert((lists[0].sizes == std::vector<int64_t>{1, 2, 4}));
+
+	lists[1].Append("c", 3, "e-c", 30);
+	lists[1].Append("d", 5, "e-d2", 50);
+
+	dss::ObjectInfos all = dss::ObjectInfos::Merge(lists, true);
+	assert((keys(all.keys) == Keys{"a", "b", "c", "d"}));
+	assert((all.sizes == std::vector<int64_t>{1, 2, 3, 4}));
+	assert((all.mtimes == std::vector<int64_t>{10, 20, 30, 40}));
+	assert((keys(all.etags) == Keys{"e-a", "e-b", "e-c", "e-d"}));
+}
+
+int main()
+{
+	test_append();
+	test_merge_runs();
+	test_random();
+	test_object_infos();
+
+	printf("keylist: all tests passed\n");
+
+	return 0;
+}
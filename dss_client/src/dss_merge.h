@@ -0,0 +1,101 @@
+/**
+  The Clear BSD License
+
+  Copyright (c) 2022 Samsung Electronics Co., Ltd.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted (subject to the limitations in the disclaimer
+  below) provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of Samsung Electronics Co., Ltd. nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+ NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#ifndef DSS_MERGE_H
+#define DSS_MERGE_H
+
+#include <functional>
+#include <iterator>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace dss {
+
+	/* Merges k individually sorted runs [first, last) into one sorted
+	 * stream handed to emit(). The heap holds one cursor per run, so the
+	 * cost is O(n log k) and nothing but the cursors is buffered.
+	 *
+	 * With dedup, an element equal to the previously emitted one is
+	 * skipped, e.g. a common prefix present in several clusters.
+	 * Elements that compare equal are taken from the lower run first */
+	template <typename It, typename Emit,
+			 typename Less = std::less<typename std::iterator_traits<It>::value_type>>
+	size_t KWayMerge(const std::vector<std::pair<It, It>>& runs, Emit emit,
+			bool dedup = false, Less less = Less())
+	{
+		struct Cursor {
+			It cur;
+			It end;
+			size_t run;
+		};
+
+		auto cmp = [&less](const Cursor& a, const Cursor& b) {
+			// priority_queue pops the largest, so order is inverted
+			if (less(*b.cur, *a.cur))
+				return true;
+			if (less(*a.cur, *b.cur))
+				return false;
+			return a.run > b.run;
+		};
+
+		std::priority_queue<Cursor, std::vector<Cursor>, decltype(cmp)> heap(cmp);
+		size_t n = 0;
+		It last;
+		bool emitted = false;
+
+		for (size_t i = 0; i < runs.size(); i++) {
+			if (runs[i].first != runs[i].second)
+				heap.push(Cursor{runs[i].first, runs[i].second, i});
+		}
+
+		while (!heap.empty()) {
+			Cursor c = heap.top();
+			heap.pop();
+
+			if (!dedup || !emitted || less(*last, *c.cur) || less(*c.cur, *last)) {
+				emit(*c.cur);
+				last = c.cur;
+				emitted = true;
+				n++;
+			}
+
+			if (++c.cur != c.end)
+				heap.push(c);
+		}
+
+		return n;
+	}
+
+} // namespace dss
+
+#endif // DSS_MERGE_H
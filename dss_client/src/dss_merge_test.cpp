@@ -0,0 +1,123 @@
+/**
+  The Clear BSD License
+
+  Copyright (c) 2022 Samsung Electronics Co., Ltd.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted (subject to the limitations in the disclaimer
+  below) provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of Samsung Electronics Co., Ltd. nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+ NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "dss_merge.h"
+
+using Run = std::vector<std::string>;
+using Range = std::pair<Run::const_iterator, Run::const_iterator>;
+
+static std::vector<std::string>
+merge(const std::vector<Run>& runs, bool dedup)
+{
+	std::vector<Range> ranges;
+	std::vector<std::string> out;
+
+	for (auto& r : runs)
+		ranges.emplace_back(r.cbegin(), r.cend());
+
+	size_t n = dss::KWayMerge(ranges,
+			[&out](const std::string& s) { out.push_back(s); }, dedup);
+	assert(n == out.size());
+
+	return out;
+}
+
+static void
+test_empty()
+{
+	assert(merge({}, false).empty());
+	assert(merge({{}, {}, {}}, true).empty());
+	assert((merge({{}, {"a", "b"}, {}}, false) == Run{"a", "b"}));
+}
+
+static void
+test_dedup()
+{
+	std::vector<Run> runs = {{"a/", "b/", "d"}, {"a/", "c"}, {"b/", "d"}};
+
+	assert((merge(runs, true) == Run{"a/", "b/", "c", "d"}));
+	assert((merge(runs, false) == Run{"a/", "a/", "b/", "b/", "c", "d", "d"}));
+}
+
+/* Keys are compared as unsigned bytes, same as S3 listing order */
+static void
+test_byte_order()
+{
+	std::vector<Run> runs = {{"a", "a\x7f", "a\xc3\xa9"}, {"a/b", "a0"}};
+
+	assert((merge(runs, false) == Run{"a", "a/b", "a0", "a\x7f", "a\xc3\xa9"}));
+}
+
+static void
+test_random()
+{
+	std::mt19937 rng(42);
+
+	for (int iter = 0; iter < 200; iter++) {
+		std::vector<Run> runs(rng() % 9);
+		std::vector<std::string> all;
+		std::set<std::string> uniq;
+
+		for (auto& r : runs) {
+			size_t n = rng() % 50;
+			for (size_t i = 0; i < n; i++)
+				r.push_back("key" + std::to_string(rng() % 100));
+			std::sort(r.begin(), r.end());
+			all.insert(all.end(), r.begin(), r.end());
+			uniq.insert(r.begin(), r.end());
+		}
+		std::sort(all.begin(), all.end());
+
+		assert(merge(runs, false) == all);
+		assert(merge(runs, true) == Run(uniq.begin(), uniq.end()));
+	}
+}
+
+int main()
+{
+	test_empty();
+	test_dedup();
+	test_byte_order();
+	test_random();
+
+	printf("kway merge: all tests passed\n");
+
+	return 0;
+}
@@ -0,0 +1,176 @@
+/**
+  The Clear BSD License
+
+  Copyright (c) 2022 Samsung Electronics Co., Ltd.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted (subject to the limitations in the disclaimer
+  below) provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of Samsung Electronics Co., Ltd. nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+ NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <limits.h>
+#include <string.h>
+#include <algorithm>
+
+#include "dss_segbuf.h"
+
+namespace dss {
+
+	SegmentStreamBuf::SegmentStreamBuf(const std::vector<struct iovec>& segs,
+			std::ios_base::openmode mode) :
+		m_size(0),
+		m_cur(0),
+		m_mode(mode & std::ios_base::out ? std::ios_base::out : std::ios_base::in)
+	{
+		// Empty segments would only get in the way of seeking
+		for (auto& s : segs) {
+			if (!s.iov_len)
+				continue;
+			m_segs.push_back(s);
+			m_starts.push_back(m_size);
+			m_size += s.iov_len;
+		}
+		SetSegment(0, 0);
+	}
+
+	void
+		SegmentStreamBuf::SetSegment(size_t i, uint64_t off)
+		{
+			m_cur = i;
+			if (i == m_segs.size()) {
+				setg(nullptr, nullptr, nullptr);
+				setp(nullptr, nullptr);
+				return;
+			}
+
+			char* base = (char*)m_segs[i].iov_base;
+			if (m_mode & std::ios_base::in) {
+				setg(base, base + off, base + m_segs[i].iov_len);
+				return;
+			}
+
+			// pbump() takes an int, segments may be larger
+			setp(base, base + m_segs[i].iov_len);
+			for (; off > INT_MAX; off -= INT_MAX)
+				pbump(INT_MAX);
+			pbump(off);
+		}
+
+	uint64_t
+		SegmentStreamBuf::Tell() const
+		{
+			if (m_cur == m_segs.size())
+				return m_size;
+
+			return m_starts[m_cur] + (m_mode & std::ios_base::in ? gptr() - eback() : pptr() - pbase());
+		}
+
+	unsigned char*
+		SegmentStreamBuf::Gather(uint64_t off, size_t len, std::vector<unsigned char>& scratch)
+		{
+			size_t i = std::upper_bound(m_starts.begin(), m_starts.end(), off) - m_starts.begin() - 1;
+			size_t done = 0;
+
+			if (i >= m_segs.size() || off + len > m_size)
+				return nullptr;
+
+			unsigned char* p = (unsigned char*)m_segs[i].iov_base + (off - m_starts[i]);
+			if (off + len <= m_starts[i] + m_segs[i].iov_len)
+				return p;
+
+			scratch.resize(len);
+			for (; done < len; i++) {
+				uint64_t skip = off + done - m_starts[i];
+				size_t n = std::min<uint64_t>(len - done, m_segs[i].iov_len - skip);
+				memcpy(scratch.data() + done, (char*)m_segs[i].iov_base + skip, n);
+				done += n;
+			}
+
+			return scratch.data();
+		}
+
+	SegmentStreamBuf::int_type
+		SegmentStreamBuf::underflow()
+		{
+			if (!(m_mode & std::ios_base::in))
+				return traits_type::eof();
+			if (gptr() == egptr() && m_cur < m_segs.size())
+				SetSegment(m_cur + 1, 0);
+			if (m_cur == m_segs.size())
+				return traits_type::eof();
+
+			return traits_type::to_int_type(*gptr());
+		}
+
+	SegmentStreamBuf::int_type
+		SegmentStreamBuf::overflow(int_type c)
+		{
+			if (!(m_mode & std::ios_base::out))
+				return traits_type::eof();
+
+			while (m_cur < m_segs.size() && pptr() == epptr())
+				SetSegment(m_cur + 1, 0);
+			if (m_cur == m_segs.size())
+				return traits_type::eof();
+
+			if (!traits_type::eq_int_type(c, traits_type::eof())) {
+				*pptr() = traits_type::to_char_type(c);
+				pbump(1);
+			}
+
+			return traits_type::not_eof(c);
+		}
+
+	SegmentStreamBuf::pos_type
+		SegmentStreamBuf::seekoff(off_type off, std::ios_base::seekdir dir,
+				std::ios_base::openmode which)
+		{
+			if (dir == std::ios_base::cur)
+				off += Tell();
+			else if (dir == std::ios_base::end)
+				off += m_size;
+
+			return seekpos(pos_type(off), which);
+		}
+
+	SegmentStreamBuf::pos_type
+		SegmentStreamBuf::seekpos(pos_type pos, std::ios_base::openmode which)
+		{
+			off_type off = pos;
+
+			if (!(which & m_mode) || off < 0 || (uint64_t)off > m_size)
+				return pos_type(off_type(-1));
+
+			size_t i = std::upper_bound(m_starts.begin(), m_starts.end(), (uint64_t)off) -
+				m_starts.begin();
+			if ((uint64_t)off == m_size)
+				SetSegment(m_segs.size(), 0);
+			else
+				SetSegment(i - 1, off - m_starts[i - 1]);
+
+			return pos;
+		}
+
+} // namespace dss
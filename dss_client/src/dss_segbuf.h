@@ -0,0 +1,80 @@
+/**
+  The Clear BSD License
+
+  Copyright (c) 2022 Samsung Electronics Co., Ltd.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted (subject to the limitations in the disclaimer
+  below) provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of Samsung Electronics Co., Ltd. nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+ NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#ifndef DSS_SEGBUF_H
+#define DSS_SEGBUF_H
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include <streambuf>
+#include <vector>
+
+namespace dss {
+
+	/* Stream over a list of caller memory segments (an iovec) taken in
+	 * order as one body, so a request can be sent from, or a response
+	 * received into, several buffers without concatenating them. Opened
+	 * for either reading or writing. Seekable, the SDK rewinds bodies on
+	 * retries. Writing past the last segment fails */
+	class SegmentStreamBuf : public std::streambuf {
+		public:
+			SegmentStreamBuf(const std::vector<struct iovec>& segs,
+					std::ios_base::openmode mode = std::ios_base::in);
+
+			uint64_t Size() const { return m_size; }
+			/* Current offset in the body */
+			uint64_t Tell() const;
+			/* Bytes [off, off + len) of the body, in place when they lie in
+			 * one segment, else copied into scratch */
+			unsigned char* Gather(uint64_t off, size_t len, std::vector<unsigned char>& scratch);
+
+		protected:
+			int_type underflow() override;
+			int_type overflow(int_type c) override;
+			pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+					std::ios_base::openmode which) override;
+			pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+		private:
+			void SetSegment(size_t i, uint64_t off);
+
+			std::vector<struct iovec> m_segs;
+			/* Offset of each segment in the body */
+			std::vector<uint64_t> m_starts;
+			uint64_t m_size;
+			size_t m_cur;
+			std::ios_base::openmode m_mode;
+	};
+
+} // namespace dss
+
+#endif // DSS_SEGBUF_H
@@ -0,0 +1,184 @@
+/**
+  The Clear BSD License
+
+  Copyright (c) 2022 Samsung Electronics Co., Ltd.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted (subject to the limitations in the disclaimer
+  below) provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice,
+ this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ * Neither the name of Samsung Electronics Co., Ltd. nor the names of its
+ contributors may be used to endorse or promote products derived from this
+ software without specific prior written permission.
+ NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **/
+
+#include <cassert>
+#include <cstdio>
+#include <istream>
+#include <ostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "dss_segbuf.h"
+
+using dss::SegmentStreamBuf;
+
+/* Body split at random points, with some empty segments thrown in */
+static std::vector<struct iovec>
+split(std::string& body, std::mt19937& rng)
+{
+	std::vector<struct iovec> segs;
+	size_t off = 0;
+
+	while (off < body.size()) {
+		size_t n = std::min<size_t>(body.size() - off, rng() % 100);
+		segs.push_back(iovec{&body[off], n});
+		off += n;
+	}
+
+	return segs;
+}
+
+static void
+test_read()
+{
+	std::mt19937 rng(1);
+
+	for (size_t size : {0, 1, 99, 1000, 12345}) {
+		std::string body(size, 0);
+		for (auto& c : body)
+			c = rng();
+
+		SegmentStreamBuf buf(split(body, rng));
+		std::istream is(&buf);
+
+		assert(buf.Size() == size);
+		assert(std::string(std::istreambuf_iterator<char>(is),
+					std::istreambuf_iterator<char>()) == body);
+	}
+}
+
+/* What the SDK does: find the length, rewind, read, rewind on retry */
+static void
+test_seek()
+{
+	std::mt19937 rng(2);
+	std::string body(5000, 0);
+	for (auto& c : body)
+		c = rng();
+
+	SegmentStreamBuf buf(split(body, rng));
+	std::istream is(&buf);
+
+	is.seekg(0, std::ios_base::end);
+	assert((size_t)is.tellg() == body.size());
+	is.seekg(0, std::ios_base::beg);
+
+	for (int i = 0; i < 200; i++) {
+		size_t pos = rng() % (body.size() + 1);
+		size_t n = rng() % 300;
+		std::string got(n, 0);
+
+		is.clear();
+		is.seekg(pos);
+		assert((size_t)is.tellg() == pos);
+		is.read(&got[0], n);
+		got.resize(is.gcount());
+		assert(got == body.substr(pos, n));
+
+		is.clear();
+		is.seekg(-(std::streamoff)got.size(), std::ios_base::cur);
+		assert((size_t)is.tellg() == pos);
+	}
+
+	is.clear();
+	is.seekg(body.size() + 1);
+	assert(is.fail());
+}
+
+static void
+test_gather()
+{
+	std::mt19937 rng(3);
+	std::string body(3000, 0);
+	std::vector<unsigned char> scratch;
+	for (auto& c : body)
+		c = rng();
+
+	SegmentStreamBuf buf(split(body, rng));
+
+	for (int i = 0; i < 500; i++) {
+		size_t off = rng() % body.size();
+		size_t len = 1 + rng() % std::min<size_t>(400, body.size() - off);
+		unsigned char* p = buf.Gather(off, len, scratch);
+
+		assert(p && std::string((char*)p, len) == body.substr(off, len));
+	}
+	assert(!buf.Gather(body.size() - 1, 2, scratch));
+}
+
+/* Response bodies written in random pieces, retried from the start */
+static void
+test_write()
+{
+	std::mt19937 rng(4);
+
+	for (size_t size : {0, 1, 99, 5000}) {
+		std::string body(size, 0), dst(size, 0);
+		for (auto& c : body)
+			c = rng();
+
+		SegmentStreamBuf buf(split(dst, rng), std::ios_base::out);
+		std::ostream os(&buf);
+
+		os.write("garbage", std::min<size_t>(size, 7));
+		os.seekp(0);
+		for (size_t off = 0; off < size; ) {
+			size_t n = std::min<size_t>(size - off, rng() % 200);
+			if (n == 1)
+				os.put(body[off]);
+			else
+				os.write(&body[off], n);
+			off += n;
+		}
+		assert(os.good());
+		assert(buf.Tell() == size);
+		assert(dst == body);
+
+		// No room past the segments
+		os.put('x');
+		assert(os.bad());
+	}
+}
+
+int main()
+{
+	test_read();
+	test_seek();
+	test_gather();
+	test_write();
+
+	printf("segbuf: all tests passed\n");
+
+	return 0;
+}
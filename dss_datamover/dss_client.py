@@ -208,17 +208,19 @@ class DssClientLib(object):
             self.logger.excep("OtherException - {} , {}".format(object_key, e))
         return ret
 
-    def listObjects(self, bucket=None, prefix="", delimiter="/"):
+    def listObjects(self, bucket=None, prefix="", delimiter="/", rank=0, world_size=1):
         """
         List object-keys under a specified prefix.
         The getObjects function has 3rd argument common_prefix should be True
         :param bucket: None ( for dss_client ) , For minio and boto3 there should be an bucket already created.
         :param prefix: A object key prefix
         :param delimiter: Default is "/" to receive first level object keys.
+        :param rank: With world_size > 1, list only the share of keys owned by this rank.
+        :param world_size: Number of processes splitting the listing.
         :return: List of object keys.
         """
         try:
-            objects = self.dss_client.getObjects(prefix, delimiter, True)
+            objects = self.dss_client.getObjects(prefix, delimiter, True, prefetch=2, rank=rank, world_size=world_size)
             while True:
                 try:
                     for obj_key in objects:
@@ -237,3 +239,22 @@ class DssClientLib(object):
             self.logger.excep("NoSuchResouceError - {}".format(e))
         except dss.GenericError as e:
             self.logger.excep("GenericError {}- {}".format(prefix, e))
+
+    def summarizePrefix(self, bucket=None, prefix="", delimiter="/"):
+        """
+        Count objects and bytes under a prefix without pulling the keys into python.
+        :param bucket: None ( for dss_client )
+        :param prefix: A object key prefix
+        :param delimiter: Totals are grouped per common prefix up to this delimiter.
+        :return: Dict of common prefix => (object count, bytes), None on failure.
+        """
+        try:
+            summary = self.dss_client.summarizePrefix(prefix, delimiter)
+            return {cp: (s.count, s.bytes) for cp, s in summary.items()}
+        except dss.NetworkError as e:
+            self.logger.excep("NetworkError - prefix:{}, {}".format(prefix, e))
+        except dss.NoSuchResouceError as e:
+            self.logger.excep("NoSuchResouceError - {}".format(e))
+        except dss.GenericError as e:
+            self.logger.excep("GenericError {}- {}".format(prefix, e))
+        return None